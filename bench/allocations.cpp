@@ -0,0 +1,96 @@
+#include <cstdlib>
+#include <new>
+
+#include "bench/harness.hpp"
+
+// Count every heap allocation for the allocs/op column. All forms of the
+// global operators are replaced, so each pointer is freed by the function
+// matching the one that allocated it. They live apart from main.cpp so the
+// compiler can't see through them into the callers.
+namespace {
+void* allocate(std::size_t size) {
+    bench::allocations().fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void* allocate(std::size_t size, std::align_val_t align) {
+    bench::allocations().fetch_add(1, std::memory_order_relaxed);
+    const std::size_t alignment = std::size_t(align);
+#ifdef _WIN32
+    return _aligned_malloc(size == 0 ? 1 : size, alignment);
+#else
+    // aligned_alloc wants a non-zero multiple of the alignment
+    const std::size_t blocks = size == 0 ? 1 : (size - 1) / alignment + 1;
+    return std::aligned_alloc(alignment, blocks * alignment);
+#endif
+}
+
+void release(void* p) { std::free(p); }
+
+void release(void* p, std::align_val_t) {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+void* or_throw(void* p) {
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+}  // namespace
+
+void* operator new(std::size_t size) { return or_throw(allocate(size)); }
+void* operator new[](std::size_t size) { return or_throw(allocate(size)); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+void* operator new(std::size_t size, std::align_val_t align) {
+    return or_throw(allocate(size, align));
+}
+void* operator new[](std::size_t size, std::align_val_t align) {
+    return or_throw(allocate(size, align));
+}
+void* operator new(std::size_t size, std::align_val_t align,
+                   const std::nothrow_t&) noexcept {
+    return allocate(size, align);
+}
+void* operator new[](std::size_t size, std::align_val_t align,
+                     const std::nothrow_t&) noexcept {
+    return allocate(size, align);
+}
+
+void operator delete(void* p) noexcept { release(p); }
+void operator delete[](void* p) noexcept { release(p); }
+void operator delete(void* p, std::size_t) noexcept { release(p); }
+void operator delete[](void* p, std::size_t) noexcept { release(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { release(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    release(p);
+}
+void operator delete(void* p, std::align_val_t align) noexcept {
+    release(p, align);
+}
+void operator delete[](void* p, std::align_val_t align) noexcept {
+    release(p, align);
+}
+void operator delete(void* p, std::size_t, std::align_val_t align) noexcept {
+    release(p, align);
+}
+void operator delete[](void* p, std::size_t, std::align_val_t align) noexcept {
+    release(p, align);
+}
+void operator delete(void* p, std::align_val_t align,
+                     const std::nothrow_t&) noexcept {
+    release(p, align);
+}
+void operator delete[](void* p, std::align_val_t align,
+                       const std::nothrow_t&) noexcept {
+    release(p, align);
+}
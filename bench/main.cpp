@@ -0,0 +1,177 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bench/harness.hpp"
+#include "bitboard.hpp"
+#include "board_2048.hpp"
+#include "board_t.hpp"
+#include "rng.hpp"
+#include "solver.hpp"
+
+namespace {
+constexpr uint64_t FIXTURE_SEED = 2048;
+constexpr uint64_t MOVE_SEED = 4096;  // a stream apart from the spawns
+
+struct fixture {
+    std::string name;  // "<size>/<phase>"
+    core::board_2048 board;
+};
+
+// Early, mid and late game positions of one game of random legal moves per
+// board size, seeded, so every build benchmarks the same boards whatever
+// the solver picks.
+std::vector<fixture> make_fixtures() {
+    std::vector<fixture> fixtures;
+    for (int size : {4, 5, 6, 8}) {
+        core::board_2048 board(size, FIXTURE_SEED + size);
+        core::rng moves(MOVE_SEED + size);
+        std::vector<core::board_2048> history;
+        while (!board.is_over()) {
+            history.push_back(board);
+            int dir = int(moves.below(4));
+            while (!board.valid_move(dir)) {
+                dir = (dir + 1) % 4;
+            }
+            board.move(dir);
+            board.add_random_tile();
+        }
+        const size_t n = history.size();
+        const std::string prefix = std::to_string(size) + "/";
+        fixtures.push_back(
+            {prefix + "early", history[std::min<size_t>(20, n - 1)]});
+        fixtures.push_back({prefix + "mid", history[n / 2]});
+        fixtures.push_back({prefix + "late", history[n > 10 ? n - 10 : 0]});
+    }
+    return fixtures;
+}
+
+template <typename Board>
+void register_board(bench::registry& reg, const std::string& type,
+                    const std::string& name, const Board& board) {
+    reg.add(type + "/move/" + name, [board](bench::state& s) {
+        Board work = board;
+        for (uint64_t i = 0; i < s.iterations(); ++i) {
+            work = board;  // same-size copy assignment, no allocation
+            work.move(int(i & 3));
+            bench::do_not_optimize(work);
+        }
+    });
+    reg.add(type + "/valid_move/" + name, [board](bench::state& s) {
+        for (uint64_t i = 0; i < s.iterations(); ++i) {
+            bench::do_not_optimize(board.valid_move(int(i & 3)));
+        }
+    });
+    reg.add(type + "/legal_moves_mask/" + name, [board](bench::state& s) {
+        for (uint64_t i = 0; i < s.iterations(); ++i) {
+            bench::do_not_optimize(board.legal_moves_mask());
+        }
+    });
+    reg.add(type + "/is_over/" + name, [board](bench::state& s) {
+        for (uint64_t i = 0; i < s.iterations(); ++i) {
+            bench::do_not_optimize(board.is_over());
+        }
+    });
+    reg.add(type + "/hash/" + name, [board](bench::state& s) {
+        for (uint64_t i = 0; i < s.iterations(); ++i) {
+            bench::do_not_optimize(board.hash());
+        }
+    });
+    reg.add(type + "/evaluate_board/" + name, [board](bench::state& s) {
+        core::solver solver;
+        for (uint64_t i = 0; i < s.iterations(); ++i) {
+            bench::do_not_optimize(solver.evaluate_board(board));
+        }
+    });
+}
+
+void register_solver(bench::registry& reg, const std::string& name,
+                     const core::board_2048& board) {
+    for (int depth : {2, 3}) {
+        reg.add(
+            "solver/expectimax/d" + std::to_string(depth) + "/" + name,
+            [board, depth](bench::state& s) {
+                core::solver solver(depth);
+                solver.set_cache_size(1 << 20);
+                for (uint64_t i = 0; i < s.iterations(); ++i) {
+                    solver.clear_cache();  // every search starts cold
+                    bench::do_not_optimize(solver.get_best_move(board));
+                    s.add_items(solver.get_node_count());
+                }
+            },
+            "nodes");
+    }
+}
+
+void usage(const char* prog) {
+    std::cerr << "usage: " << prog << " [options]\n"
+              << "  --filter STR    only run benchmarks whose name contains "
+                 "STR\n"
+              << "  --min-time S    minimum seconds per benchmark (0.2)\n"
+              << "  --json FILE     also write results as JSON to FILE\n";
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::string filter, json_path;
+    double min_time = 0.2;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            usage(argv[0]);
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        const char* value = argv[++i];
+        if (arg == "--filter") {
+            filter = value;
+        } else if (arg == "--min-time") {
+            min_time = std::atof(value);
+        } else if (arg == "--json") {
+            json_path = value;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    bench::registry reg;
+    for (auto& f : make_fixtures()) {
+        register_board(reg, "board_2048", f.name, f.board);
+        if (core::bitboard::fits(f.board)) {
+            register_board(reg, "bitboard", f.name, core::bitboard(f.board));
+        }
+        if (f.board.size() == 5) {
+            register_board(reg, "board_t", f.name, core::board_t<5>(f.board));
+        } else if (f.board.size() == 6) {
+            register_board(reg, "board_t", f.name, core::board_t<6>(f.board));
+        } else if (f.board.size() == 8) {
+            register_board(reg, "board_t", f.name, core::board_t<8>(f.board));
+        }
+        register_solver(reg, f.name, f.board);
+    }
+
+    const auto results =
+        reg.run(filter, std::chrono::duration<double>(min_time),
+                [](const bench::result& r) {
+                    std::cout << bench::format_row(r) << std::endl;
+                });
+
+    if (!json_path.empty()) {
+        std::ofstream out(json_path);
+        if (!out) {
+            std::cerr << "cannot open " << json_path << "\n";
+            return 1;
+        }
+#ifdef NDEBUG
+        bench::write_json(out, results, "release");
+#else
+        bench::write_json(out, results, "debug");
+#endif
+    }
+    return 0;
+}
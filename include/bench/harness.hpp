@@ -0,0 +1,168 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Minimal microbenchmark harness in the spirit of Google Benchmark: each
+// benchmark runs its body for a growing number of iterations until the batch
+// takes at least `min_time`, then reports time, custom rates and heap
+// allocations per iteration. Allocation counting relies on the executable
+// replacing the global operator new and bumping `allocations()`.
+namespace bench {
+inline std::atomic<uint64_t>& allocations() {
+    static std::atomic<uint64_t> count = 0;
+    return count;
+}
+
+template <typename T>
+inline void do_not_optimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static const void* volatile sink;
+    sink = &value;
+#endif
+}
+
+// Passed to the benchmark body; the body runs `iterations()` times and may
+// report work done (e.g. search nodes) through `add_items`.
+class state {
+   public:
+    explicit state(uint64_t iterations) : iters(iterations) {}
+
+    uint64_t iterations() const { return iters; }
+
+    void add_items(uint64_t count) { items += count; }
+
+    uint64_t items_processed() const { return items; }
+
+   private:
+    uint64_t iters;
+    uint64_t items = 0;
+};
+
+struct result {
+    std::string name;
+    uint64_t iterations = 0;
+    double ns_per_op = 0;
+    double items_per_second = 0;  // 0 when the body reports no items
+    double allocs_per_op = 0;
+    std::string items_label;
+};
+
+struct benchmark {
+    std::string name;
+    std::string items_label;  // e.g. "nodes"; empty for plain timings
+    std::function<void(state&)> body;
+};
+
+class registry {
+   public:
+    void add(std::string name, std::function<void(state&)> body,
+             std::string items_label = {}) {
+        benchmarks.push_back(
+            {std::move(name), std::move(items_label), std::move(body)});
+    }
+
+    std::vector<result> run(const std::string& filter,
+                            std::chrono::duration<double> min_time,
+                            const std::function<void(const result&)>& on_result) {
+        std::vector<result> results;
+        for (auto& b : benchmarks) {
+            if (!filter.empty() && b.name.find(filter) == std::string::npos) {
+                continue;
+            }
+            results.push_back(run_one(b, min_time));
+            on_result(results.back());
+        }
+        return results;
+    }
+
+   private:
+    std::vector<benchmark> benchmarks;
+
+    static result run_one(const benchmark& b,
+                          std::chrono::duration<double> min_time) {
+        using clock = std::chrono::steady_clock;
+        uint64_t iterations = 1;
+        while (true) {
+            state s(iterations);
+            const uint64_t allocs_before = allocations().load();
+            const auto start = clock::now();
+            b.body(s);
+            const std::chrono::duration<double> elapsed = clock::now() - start;
+            const uint64_t allocs = allocations().load() - allocs_before;
+            if (elapsed >= min_time || iterations >= (1ULL << 40)) {
+                result r;
+                r.name = b.name;
+                r.iterations = iterations;
+                r.ns_per_op = elapsed.count() * 1e9 / iterations;
+                r.items_per_second =
+                    s.items_processed() == 0
+                        ? 0
+                        : s.items_processed() / elapsed.count();
+                r.allocs_per_op = double(allocs) / iterations;
+                r.items_label = b.items_label;
+                return r;
+            }
+            // aim slightly past min_time, grow at most 10x per round
+            const double scale =
+                elapsed.count() <= 0
+                    ? 10
+                    : std::clamp(1.4 * min_time.count() / elapsed.count(), 2.0,
+                                 10.0);
+            iterations = uint64_t(iterations * scale);
+        }
+    }
+};
+
+inline std::string json_escape(const std::string& str) {
+    std::string out;
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out;
+}
+
+inline void write_json(std::ostream& out, const std::vector<result>& results,
+                       const std::string& build) {
+    out << "{\n  \"context\": {\"build\": \"" << json_escape(build)
+        << "\"},\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const result& r = results[i];
+        out << (i == 0 ? "\n" : ",\n") << "    {\"name\": \""
+            << json_escape(r.name) << "\", \"iterations\": " << r.iterations
+            << ", \"ns_per_op\": " << std::setprecision(6) << r.ns_per_op
+            << ", \"allocs_per_op\": " << r.allocs_per_op;
+        if (!r.items_label.empty()) {
+            out << ", \"" << json_escape(r.items_label)
+                << "_per_second\": " << r.items_per_second;
+        }
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+inline std::string format_row(const result& r) {
+    std::ostringstream line;
+    line << std::left << std::setw(44) << r.name << std::right
+         << std::setw(14) << std::fixed << std::setprecision(1) << r.ns_per_op
+         << " ns/op" << std::setw(10) << std::setprecision(2)
+         << r.allocs_per_op << " allocs/op";
+    if (!r.items_label.empty()) {
+        line << std::setw(14) << std::setprecision(0) << r.items_per_second
+             << ' ' << r.items_label << "/s";
+    }
+    return line.str();
+}
+}  // namespace bench
@@ -0,0 +1,251 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <utility>
+
+#include "board_2048.hpp"
+#include "hash.hpp"
+#include "move_tables.hpp"
+#include "rng.hpp"
+#include "symmetry.hpp"
+namespace core {
+// 4x4 board packed into a single 64-bit word. Every cell holds the 4-bit log2
+// exponent of its tile (0 = empty); cell (x, y) lives in nibble x * 4 + y, so
+// row x is the 16-bit lane starting at bit 16 * x. Copying, comparing and
+// hashing are register operations. Exponents stop at 15 (32768): two 32768
+// tiles are treated as unmergeable.
+class bitboard {
+   public:
+    using raw_t = uint64_t;
+    static constexpr int brd_size = 4;
+    static constexpr int MAX_EXPONENT = row_table::MAX_EXPONENT;
+
+    bitboard() = default;
+
+    explicit bitboard(raw_t bits, uint64_t score = 0)
+        : bits(bits), score(score) {}
+
+    explicit bitboard(const board_2048& board) : score(board.get_score()) {
+        for (int x = 0; x < brd_size; ++x) {
+            for (int y = 0; y < brd_size; ++y) {
+                set_tile(x, y, board.get_tile(x, y));
+            }
+        }
+    }
+
+    // whether `board` can be represented and moved as board_2048 moves it:
+    // a 32768 tile could merge with another, which the packed table can't
+    static bool fits(const board_2048& board) {
+        if (board.size() != brd_size) {
+            return false;
+        }
+        for (auto& tile : board.brd) {
+            if (tile >= (1 << MAX_EXPONENT)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    board_2048 to_board() const {
+        board_2048 board(brd_size);
+        for (int x = 0; x < brd_size; ++x) {
+            for (int y = 0; y < brd_size; ++y) {
+                board.set_tile(x, y, get_tile(x, y));
+            }
+        }
+        board.score = score;
+        return board;
+    }
+
+    void move(int dir);
+
+    bool valid_move(int dir) const {
+        bitboard test_brd = *this;
+        test_brd.move(dir);
+        return test_brd.bits != bits;
+    }
+
+    // bit `1 << dir` set for every direction that changes the board
+    int legal_moves_mask() const;
+
+    bool is_over() const { return legal_moves_mask() == 0; }
+
+    // the packed board stays 16 bytes, so the generator lives with the game
+    void add_random_tile(rng& engine);
+
+    int get_exponent(int x, int y) const {
+        return (bits >> (4 * pos2n(x, y))) & 0xF;
+    }
+
+    void set_exponent(int x, int y, int exponent) {
+        const int shift = 4 * pos2n(x, y);
+        bits = (bits & ~(raw_t(0xF) << shift)) | (raw_t(exponent) << shift);
+    }
+
+    int get_tile(int x, int y) const {
+        const int exponent = get_exponent(x, y);
+        return exponent ? 1 << exponent : 0;
+    }
+
+    void set_tile(int x, int y, int val) {
+        set_exponent(x, y, val ? std::countr_zero(unsigned(val)) : 0);
+    }
+
+    int count_empty_tiles() const { return std::popcount(empty_mask()); }
+
+    int count_tiles() const { return brd_size * brd_size - count_empty_tiles(); }
+
+    int count_distinct_tiles() const {
+        uint64_t mask = 0;
+        for (raw_t b = bits; b; b >>= 4) {
+            if (b & 0xF) {
+                mask |= 1ULL << (b & 0xF);
+            }
+        }
+        return std::popcount(mask);
+    }
+
+    int size() const { return brd_size; }
+
+    uint64_t hash() const { return fmix64(bits); }
+
+    bool operator==(const bitboard& brd) const { return bits == brd.bits; }
+
+    uint64_t get_score() const { return score; }
+
+    raw_t raw() const { return bits; }
+
+    // cell (x, y) moves to (y, x)
+    static raw_t transpose(raw_t b) {
+        const raw_t a1 = b & 0xF0F00F0FF0F00F0FULL;
+        const raw_t a2 = b & 0x0000F0F00000F0F0ULL;
+        const raw_t a3 = b & 0x0F0F00000F0F0000ULL;
+        const raw_t a = a1 | (a2 << 12) | (a3 >> 12);
+        const raw_t b1 = a & 0xFF00FF0000FF00FFULL;
+        const raw_t b2 = a & 0x00FF00FF00000000ULL;
+        const raw_t b3 = a & 0x00000000FF00FF00ULL;
+        return b1 | (b2 >> 24) | (b3 << 24);
+    }
+
+    // cell (x, y) moves to (x, 3 - y): nibbles reversed within each row
+    static raw_t mirror_columns(raw_t b) {
+        b = ((b & 0x0F0F0F0F0F0F0F0FULL) << 4) |
+            ((b >> 4) & 0x0F0F0F0F0F0F0F0FULL);
+        return ((b & 0x00FF00FF00FF00FFULL) << 8) |
+               ((b >> 8) & 0x00FF00FF00FF00FFULL);
+    }
+
+    // cell (x, y) moves to (3 - x, y): the order of the rows reversed
+    static raw_t mirror_rows(raw_t b) {
+        b = (b << 32) | (b >> 32);
+        return ((b & 0x0000FFFF0000FFFFULL) << 16) |
+               ((b >> 16) & 0x0000FFFF0000FFFFULL);
+    }
+
+    // Least of the eight images of `b` (numbered as in symmetry), and the
+    // symmetry giving it.
+    static std::pair<raw_t, int> canonical(raw_t b) {
+        std::pair<raw_t, int> best{b, 0};
+        const raw_t columns = mirror_columns(b);
+        const raw_t mirrors[symmetry::MIRRORS] = {b, columns, mirror_rows(b),
+                                                  mirror_rows(columns)};
+        for (int sym = 0; sym < symmetry::MIRRORS; ++sym) {
+            best = std::min(best, {mirrors[sym], sym});
+            best = std::min(best, {transpose(mirrors[sym]), sym + 4});
+        }
+        return best;
+    }
+
+   private:
+    raw_t bits = 0;
+    uint64_t score = 0;
+
+    static int pos2n(int x, int y) { return x * brd_size + y; }
+
+    // one bit (the low bit of the nibble) set for every empty cell
+    raw_t empty_mask() const {
+        raw_t b = bits;
+        b |= b >> 2;
+        b |= b >> 1;
+        return ~b & 0x1111111111111111ULL;
+    }
+
+    static raw_t move_rows_left(raw_t b, uint64_t& gain) {
+        const row_table& table = row_tables();
+        raw_t ret = 0;
+        for (int i = 0; i < brd_size; ++i) {
+            const uint16_t row = uint16_t(b >> (16 * i));
+            gain += table.score[row];
+            ret |= raw_t(table.left[row]) << (16 * i);
+        }
+        return ret;
+    }
+
+    static raw_t move_rows_right(raw_t b, uint64_t& gain) {
+        const row_table& table = row_tables();
+        raw_t ret = 0;
+        for (int i = 0; i < brd_size; ++i) {
+            const uint16_t row = uint16_t(b >> (16 * i));
+            gain += table.score[row_table::reverse_row(row)];
+            ret |= raw_t(table.right[row]) << (16 * i);
+        }
+        return ret;
+    }
+};
+
+inline void bitboard::move(int dir) {
+    switch (dir) {
+        case direction::left:
+            bits = move_rows_left(bits, score);
+            break;
+        case direction::right:
+            bits = move_rows_right(bits, score);
+            break;
+        case direction::up:
+            bits = transpose(move_rows_left(transpose(bits), score));
+            break;
+        case direction::down:
+            bits = transpose(move_rows_right(transpose(bits), score));
+            break;
+        default:
+            break;
+    }
+}
+
+inline int bitboard::legal_moves_mask() const {
+    // a row can move iff its table entry differs from the row itself
+    const row_table& table = row_tables();
+    const raw_t cols = transpose(bits);
+    int mask = 0;
+    for (int i = 0; i < brd_size; ++i) {
+        const uint16_t row = uint16_t(bits >> (16 * i));
+        const uint16_t col = uint16_t(cols >> (16 * i));
+        mask |= (table.left[row] != row) << direction::left;
+        mask |= (table.right[row] != row) << direction::right;
+        mask |= (table.left[col] != col) << direction::up;
+        mask |= (table.right[col] != col) << direction::down;
+    }
+    return mask;
+}
+
+inline void bitboard::add_random_tile(rng& engine) {
+    // same single draw as board_2048::add_random_tile
+    raw_t empty = empty_mask();
+    const int cnt = std::popcount(empty);
+    if (cnt == 0) {
+        return;
+    }
+    const uint32_t r = engine.below(uint32_t(cnt) * 10);
+    for (uint32_t k = r / 10; k > 0; --k) {
+        empty &= empty - 1;
+    }
+    const int shift = std::countr_zero(empty);
+    bits |= raw_t(r % 10 == 0 ? 2 : 1) << shift;
+}
+}  // namespace core
+template <>
+struct std::hash<core::bitboard> {
+    uint64_t operator()(const core::bitboard& brd) const { return brd.hash(); }
+};
@@ -1,22 +1,41 @@
 ﻿#pragma once
 #include <algorithm>
+#include <array>
+#include <bit>
 #include <random>
 #include <ranges>
 #include <vector>
 
 #include "coord.hpp"
+#include "move_tables.hpp"
+#include "rng.hpp"
+#include "row_kernel.hpp"
+#include "symmetry.hpp"
+#include "zobrist.hpp"
 namespace tui {
 class BoardBase;
 }
 namespace core {
 struct solver;
-inline std::default_random_engine gen(std::random_device{}());
+class bitboard;
+
+// Where one tile went in a move; cells are x * size + y
+struct tile_move {
+    int from;
+    int to;
+    bool merged;  // merged with the other tile moving to `to`
+};
+
 class board_2048 {
    public:
     friend class tui::BoardBase;
     friend struct solver;
-    using iter_type = std::vector<int>::iterator;
-    board_2048(int size = 4) : brd_size(size) {
+    friend class bitboard;
+    board_2048(int size = 4) : board_2048(size, random_seed()) {}
+
+    // Same seed, same starting tiles and same spawns for the same moves
+    board_2048(int size, uint64_t seed)
+        : brd_size(size), zobrist(&zobrist_table::of_size(size)), engine(seed) {
         brd.resize(size * size, 0);
         add_random_tile();
         if (size * size >= 2) {
@@ -24,17 +43,26 @@ class board_2048 {
         }
     }
 
+    // Reseeds the spawn generator, the tiles stay as they are
+    void seed(uint64_t seed) { engine.seed(seed); }
+
     void move(int dir);
 
-    void move_record(int dir);
+    // move(dir), also appending where every tile went to `moves`, one
+    // entry per tile in line order
+    void move(int dir, std::vector<tile_move>& moves);
 
     bool valid_move(int dir) const;
 
-    void add_random_tile();
+    // bit `1 << dir` set for every direction that changes the board
+    int legal_moves_mask() const;
+
+    // Returns the cell the tile spawned in, -1 if the board is full
+    int add_random_tile();
 
     int get_tile(int x, int y) const { return brd[x * brd_size + y]; }
 
-    void set_tile(int x, int y, int val) { brd[x * brd_size + y] = val; }
+    void set_tile(int x, int y, int val) { set_cell(pos2n(x, y), val); }
 
     int count_tiles() const {
         int cnt = 0;
@@ -66,21 +94,17 @@ class board_2048 {
 
     int size() const { return brd_size; }
 
-    bool is_over() const {
-        if (valid_move(direction::left) || valid_move(direction::down) ||
-            valid_move(direction::right) || valid_move(direction::up)) {
-            return false;
-        } else {
-            return true;
-        }
-    }
+    bool is_over() const { return legal_moves_mask() == 0; }
 
-    uint64_t hash() const {
-        uint64_t hash_value = 0;
-        for (int i = 0; i < brd.size(); ++i) {
-            hash_value = hash_value * 31 + brd[i];
-        }
-        return hash_value;
+    // Zobrist hash of the tiles, kept up to date by every edit. The search
+    // runs on board_t and bitboard up to 8x8, which hash their packed cells
+    // instead, so this serves the larger boards and the game itself.
+    uint64_t hash() const { return hash_value; }
+
+    // The hash the image of the board under symmetry `sym` would have;
+    // computed from the tiles, O(size^2), unless `sym` is the identity.
+    uint64_t hash(int sym) const {
+        return sym == 0 ? hash_value : compute_hash(sym);
     }
 
     bool operator==(const board_2048& brd) const {
@@ -89,264 +113,248 @@ class board_2048 {
 
     uint64_t get_score() const { return score; }
 
+    void set_score(uint64_t value) { score = value; }
+
    private:
     int brd_size = 4;
     uint64_t score = 0;
     std::vector<int> brd;
-    std::vector<std::pair<int, int>> records;
+    const zobrist_table* zobrist;
+    uint64_t hash_value = 0;
+    rng engine;
 
     int pos2n(int x, int y) const { return x * brd_size + y; };
 
-    void slide_row(std::vector<int>& row) {
-        slide_row(row.begin(), row.end());
-    };
-
-    void slide_row(iter_type begin, iter_type end);
-
-    void slide_row_record(iter_type begin, iter_type end, int row);
-
-    void init_row_record(iter_type begin, iter_type end, int row);
-
-    void merge_row(std::vector<int>& row) {
-        merge_row(row.begin(), row.end());
-    };
-
-    void merge_row(iter_type begin, iter_type end);
-
-    void merge_row_record(iter_type begin, iter_type end, int row);
-
-    void slide_and_merge_row(std::vector<int>& row) {
-        slide_and_merge_row(row.begin(), row.end());
-    };
+    static int exponent_of(int tile) {
+        return tile ? std::countr_zero(unsigned(tile)) : 0;
+    }
 
-    void slide_and_merge_row(iter_type begin, iter_type end);
+    // Every write to a cell goes through here to keep the hashes current
+    void set_cell(int n, int val) {
+        if (brd[n] == val) {
+            return;
+        }
+        hash_value ^= zobrist->key(n, exponent_of(brd[n])) ^
+                      zobrist->key(n, exponent_of(val));
+        brd[n] = val;
+    }
 
-    void rotate_board_r();
+    // Zobrist hash of the image under `sym`, from scratch
+    uint64_t compute_hash(int sym) const {
+        uint64_t h = 0;
+        for (int x = 0; x < brd_size; ++x) {
+            for (int y = 0; y < brd_size; ++y) {
+                const auto [ix, iy] = symmetry::image_cell(sym, brd_size, x, y);
+                h ^= zobrist->key(pos2n(ix, iy), exponent_of(brd[pos2n(x, y)]));
+            }
+        }
+        return h;
+    }
 
-    void rotate_board_l();
+    // Recomputes the hash after the cells were rewritten wholesale
+    void rehash() { hash_value = compute_hash(0); }
+
+    // index of the j-th cell of `line`, counted from the side tiles move to
+    int line_pos(int dir, int line, int j) const {
+        switch (dir) {
+            case direction::down:
+                return pos2n(brd_size - 1 - j, line);
+            case direction::right:
+                return pos2n(line, brd_size - 1 - j);
+            case direction::up:
+                return pos2n(j, line);
+            default:
+                return pos2n(line, j);
+        }
+    }
 
-    void rotate_board_180();
+    bool fits_row_table() const;
 
-    void rotate_to_left_from(int);
+    void move_packed(int dir);
 
-    void rotate_from_left_to(int);
+    template <typename Track>
+    void move_lines(int dir, Track&& track);
 };
 
-void board_2048::add_random_tile() {
-    std::uniform_int_distribution<int> dist(0, brd_size * brd_size - 1);
-    int index;
-    do {
-        index = dist(gen);
-    } while (brd[index] != 0);
-    brd[index] = dist(gen) % 10 == 0 ? 4 : 2;
-}
-
-inline void board_2048::slide_row(iter_type begin, iter_type end) {
-    // Slide non-zero elements to the left
-    iter_type index = begin;
-    for (iter_type it = begin; it != end; ++it) {
-        if (*it != 0) {
-            if (index == it) {
-                index++;
-            } else {
-                *index++ = *it;
-                *it = 0;
-            }
+inline int board_2048::add_random_tile() {
+    // One draw picks both the empty cell and, one time in ten, a 4
+    const int cnt = count_empty_tiles();
+    if (cnt == 0) {
+        return -1;
+    }
+    const uint32_t r = engine.below(uint32_t(cnt) * 10);
+    int k = int(r / 10);
+    for (int n = 0; n < brd_size * brd_size; ++n) {
+        if (!brd[n] && k-- == 0) {
+            set_cell(n, r % 10 == 0 ? 4 : 2);
+            return n;
         }
     }
+    return -1;
 }
 
-inline void board_2048::slide_row_record(iter_type begin, iter_type end,
-                                         int row) {
-    // Slide non-zero elements to the left and record where the elements go
-    iter_type index = begin;  // the last zero element
-    for (iter_type it = begin; it != end; ++it) {
-        if (*it != 0) {
-            if (index == it) {
-                index++;
-            } else {
-                // pair: first: value | second: where to go
-                for (auto j = it; j < end; ++j) {
-                    auto& p = records[pos2n(row, (j - begin))];
-                    if (p.second == pos2n(row, it - begin)) {
-                        p.second = pos2n(row, index - begin);
-                    }
-                }
-                *index++ = *it;
-                *it = 0;
-            }
+inline bool board_2048::fits_row_table() const {
+    if (brd_size != row_table::ROW_SIZE) {
+        return false;
+    }
+    for (auto& tile : brd) {
+        if (tile >= (1 << row_table::MAX_EXPONENT)) {
+            return false;
         }
     }
+    return true;
 }
 
-inline void board_2048::init_row_record(iter_type begin, iter_type end,
-                                        int row) {
-    iter_type index = begin;  // the last zero element
-    for (iter_type it = begin; it != end; ++it) {
-        if (*it != 0) {
-            records[pos2n(row, (it - begin))] = {*it, pos2n(row, (it - begin))};
+inline void board_2048::move_packed(int dir) {
+    // Walk every line in move order, so each one is a left move on the table
+    const row_table& table = row_tables();
+    constexpr int n = row_table::ROW_SIZE;
+    for (int i = 0; i < n; ++i) {
+        int index[n];
+        for (int j = 0; j < n; ++j) {
+            index[j] = line_pos(dir, i, j);
+        }
+        uint16_t row = 0;
+        for (int j = 0; j < n; ++j) {
+            if (int tile = brd[index[j]]) {
+                row |= uint16_t(std::countr_zero(unsigned(tile)) << (4 * j));
+            }
+        }
+        score += table.score[row];
+        row = table.left[row];
+        for (int j = 0; j < n; ++j) {
+            const int exponent = (row >> (4 * j)) & 0xF;
+            set_cell(index[j], exponent ? 1 << exponent : 0);
         }
     }
 }
 
-inline void board_2048::merge_row(iter_type begin, iter_type end) {
-    // Merge adjacent equal elements
-    for (iter_type it = begin; it != end - 1; ++it) {
-        if (*it != 0 && *it == *(it + 1)) {
-            *it += *it;
-            *(it + 1) = 0;
-            score += *it;
-        }
+void board_2048::move(int dir) {
+    if (fits_row_table()) {
+        move_packed(dir);
+        return;
     }
-}
 
-inline void board_2048::merge_row_record(iter_type begin, iter_type end,
-                                         int row) {
-    // Merge adjacent equal elements and update target pos;
-    for (iter_type it = begin; it != end - 1; ++it) {
-        if (*it != 0 && *it == *(it + 1)) {
-            for (auto j = it + 1; j < end; ++j) {
-                if (auto& p = records[pos2n(row, (j - begin))];
-                    p.first != 0 && p.second == pos2n(row, it + 1 - begin)) {
-                    p.second -= 1;
-                }
+    // Walk every line in move order, so each one is a left move, and write
+    // back only the cells that changed
+    const int step = line_pos(dir, 0, 1) - line_pos(dir, 0, 0);
+    if (brd_size <= row_kernel::MAX_WIDTH) {
+        for (int i = 0; i < brd_size; ++i) {
+            const int start = line_pos(dir, i, 0);
+            row_kernel::row line{};
+            for (int j = 0; j < brd_size; ++j) {
+                line[j] = uint8_t(exponent_of(brd[start + j * step]));
+            }
+            score += row_kernel::slide_and_merge(line, brd_size);
+            for (int j = 0; j < brd_size; ++j) {
+                set_cell(start + j * step, line[j] ? 1 << line[j] : 0);
             }
-            *it += *it;
-            *(it + 1) = 0;
-            score += *it;
         }
+        return;
     }
+    move_lines(dir, [](int, int, bool) {});
 }
 
-void board_2048::slide_and_merge_row(iter_type begin, iter_type end) {
-    slide_row(begin, end);
-    merge_row(begin, end);
-    slide_row(begin, end);
+inline void board_2048::move(int dir, std::vector<tile_move>& moves) {
+    move_lines(dir, [&moves](int from, int to, bool merged) {
+        moves.push_back({from, to, merged});
+    });
 }
 
-void board_2048::rotate_board_r() {
-    std::vector<int> new_brd(brd_size * brd_size);
+// One pass over every line in move order: a tile merges into the previous
+// tile if that one is equal and has not merged yet, otherwise it slides to
+// the next free cell. track(from, to, merged) is told where each tile went
+// once it is known whether the next tile merges with it.
+template <typename Track>
+void board_2048::move_lines(int dir, Track&& track) {
+    const int step = line_pos(dir, 0, 1) - line_pos(dir, 0, 0);
     for (int i = 0; i < brd_size; ++i) {
+        const int start = line_pos(dir, i, 0);
+        int filled = 0;     // cells taken at the front of the line
+        int mergeable = 0;  // the last of them, unless it merged
+        int last_from = -1;  // where that tile came from, until tracked
         for (int j = 0; j < brd_size; ++j) {
-            new_brd[j * brd_size + (brd_size - 1 - i)] = brd[i * brd_size + j];
+            const int cell = start + j * step;
+            const int tile = brd[cell];
+            if (tile == 0) {
+                continue;
+            }
+            const int last = start + (filled - 1) * step;
+            if (tile == mergeable) {
+                set_cell(cell, 0);
+                set_cell(last, tile * 2);
+                score += tile * 2;
+                track(last_from, last, true);
+                track(cell, last, true);
+                mergeable = 0;
+                last_from = -1;
+                continue;
+            }
+            if (last_from != -1) {
+                track(last_from, last, false);
+            }
+            const int to = start + filled * step;
+            if (to != cell) {
+                set_cell(cell, 0);
+                set_cell(to, tile);
+            }
+            ++filled;
+            mergeable = tile;
+            last_from = cell;
         }
-    }
-    brd = std::move(new_brd);
-}
-
-void board_2048::rotate_board_l() {
-    std::vector<int> new_brd(brd_size * brd_size);
-    for (int i = 0; i < brd_size; ++i) {
-        for (int j = 0; j < brd_size; ++j) {
-            new_brd[(brd_size - 1 - j) * brd_size + i] = brd[i * brd_size + j];
+        if (last_from != -1) {
+            track(last_from, start + (filled - 1) * step, false);
         }
     }
-    brd = std::move(new_brd);
 }
 
-void board_2048::rotate_board_180() {
-    std::vector<int> new_brd(brd_size * brd_size);
+inline bool board_2048::valid_move(int dir) const {
+    // A move changes the board iff some tile has an empty cell or an equal
+    // tile right in front of it
     for (int i = 0; i < brd_size; ++i) {
-        for (int j = 0; j < brd_size; ++j) {
-            new_brd[(brd_size - 1 - i) * brd_size + brd_size - 1 - j] =
-                brd[i * brd_size + j];
+        for (int j = 0; j + 1 < brd_size; ++j) {
+            const int front = brd[line_pos(dir, i, j)];
+            const int back = brd[line_pos(dir, i, j + 1)];
+            if (back != 0 && (front == 0 || front == back)) {
+                return true;
+            }
         }
     }
-    brd = std::move(new_brd);
-}
-
-inline void board_2048::rotate_to_left_from(int dir) {
-    // Rotate the board to simplify the move logic
-    switch (dir) {
-        case direction::left:
-            break;
-        case direction::down:
-            rotate_board_r();
-            break;
-        case direction::right:
-            rotate_board_180();
-            break;
-        case direction::up:
-            rotate_board_l();
-            break;
-        default:
-            break;
-    }
+    return false;
 }
 
-inline void board_2048::rotate_from_left_to(int dir) {
-    // Rotate the board back to the original orientation
-    switch (dir) {
-        case direction::left:
-            break;
-        case direction::down:
-            rotate_board_l();
-            break;
-        case direction::right:
-            rotate_board_180();
-            break;
-        case direction::up:
-            rotate_board_r();
-            break;
-        default:
+inline int board_2048::legal_moves_mask() const {
+    // One pass over all neighbouring pairs answers all four directions
+    int mask = 0;
+    for (int x = 0; x < brd_size; ++x) {
+        for (int y = 0; y < brd_size; ++y) {
+            const int tile = brd[pos2n(x, y)];
+            if (y + 1 < brd_size) {
+                const int right = brd[pos2n(x, y + 1)];
+                if (tile != 0 && tile == right) {
+                    mask |= (1 << direction::left) | (1 << direction::right);
+                } else if (tile == 0 && right != 0) {
+                    mask |= 1 << direction::left;
+                } else if (tile != 0 && right == 0) {
+                    mask |= 1 << direction::right;
+                }
+            }
+            if (x + 1 < brd_size) {
+                const int below = brd[pos2n(x + 1, y)];
+                if (tile != 0 && tile == below) {
+                    mask |= (1 << direction::up) | (1 << direction::down);
+                } else if (tile == 0 && below != 0) {
+                    mask |= 1 << direction::up;
+                } else if (tile != 0 && below == 0) {
+                    mask |= 1 << direction::down;
+                }
+            }
+        }
+        if (mask == 0b1111) {
             break;
+        }
     }
-}
-
-void board_2048::move(int dir) {
-    rotate_to_left_from(dir);
-
-    // Move left
-    for (int i = 0; i < brd_size; ++i) {
-        slide_and_merge_row(brd.begin() + i * brd_size,
-                            brd.begin() + (i + 1) * brd_size);
-    }
-
-    rotate_from_left_to(dir);
-}
-
-inline void board_2048::move_record(int dir) {
-    records.clear();
-    records.resize(brd_size * brd_size);
-
-    rotate_to_left_from(dir);
-
-    for (int i = 0; i < brd_size; ++i) {
-        init_row_record(brd.begin() + i * brd_size,
-                        brd.begin() + (i + 1) * brd_size, i);
-        slide_row_record(brd.begin() + i * brd_size,
-                         brd.begin() + (i + 1) * brd_size, i);
-        merge_row_record(brd.begin() + i * brd_size,
-                         brd.begin() + (i + 1) * brd_size, i);
-        slide_row_record(brd.begin() + i * brd_size,
-                         brd.begin() + (i + 1) * brd_size, i);
-    }
-
-    rotate_from_left_to(dir);
-}
-
-inline bool board_2048::valid_move(int dir) const {
-    board_2048 test_brd = *this;
-    std::vector<int> original_brd = test_brd.brd;
-
-    test_brd.rotate_to_left_from(dir);
-
-    // Move left
-    for (int i = 0; i < brd_size; ++i) {
-        test_brd.slide_and_merge_row(
-            test_brd.brd.begin() + i * brd_size,
-            test_brd.brd.begin() + (i + 1) * test_brd.brd_size);
-    }
-
-    test_brd.rotate_from_left_to(dir);
-
-    bool ret = false;
-    if (test_brd.brd != original_brd) {
-        ret = true;
-    } else {
-        ret = false;
-    }
-    return ret;
+    return mask;
 }
 }  // namespace core
 template <>
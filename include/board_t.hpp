@@ -0,0 +1,228 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+#include "bitboard.hpp"
+#include "board_2048.hpp"
+#include "hash.hpp"
+#include "row_kernel.hpp"
+namespace core {
+// Board with its size fixed at compile time: log2 exponents in a
+// std::array, so copies are a memcpy and every loop in the move and
+// evaluation kernels has a constant trip count the compiler can unroll.
+// Mirrors the board_2048 API used by the solver.
+template <int N>
+class board_t {
+   public:
+    static_assert(N >= 2 && N * N <= 64);
+    static constexpr int brd_size = N;
+    static constexpr int CELLS = N * N;
+
+    constexpr board_t() = default;
+
+    explicit board_t(const board_2048& board) : score(board.get_score()) {
+        for (int x = 0; x < N; ++x) {
+            for (int y = 0; y < N; ++y) {
+                set_tile(x, y, board.get_tile(x, y));
+            }
+        }
+    }
+
+    constexpr void move(int dir) {
+        switch (dir) {
+            case direction::down:
+                return move_lines<direction::down>();
+            case direction::right:
+                return move_lines<direction::right>();
+            case direction::up:
+                return move_lines<direction::up>();
+            default:
+                return move_lines<direction::left>();
+        }
+    }
+
+    constexpr bool valid_move(int dir) const {
+        switch (dir) {
+            case direction::down:
+                return can_move_lines<direction::down>();
+            case direction::right:
+                return can_move_lines<direction::right>();
+            case direction::up:
+                return can_move_lines<direction::up>();
+            default:
+                return can_move_lines<direction::left>();
+        }
+    }
+
+    // bit `1 << dir` set for every direction that changes the board
+    constexpr int legal_moves_mask() const {
+        int mask = 0;
+        for (int x = 0; x < N; ++x) {
+            for (int y = 0; y < N; ++y) {
+                const int tile = cells[pos2n(x, y)];
+                if (y + 1 < N) {
+                    mask |= pair_mask(tile, cells[pos2n(x, y + 1)],
+                                      direction::left, direction::right);
+                }
+                if (x + 1 < N) {
+                    mask |= pair_mask(tile, cells[pos2n(x + 1, y)],
+                                      direction::up, direction::down);
+                }
+            }
+            if (mask == 0b1111) {
+                break;
+            }
+        }
+        return mask;
+    }
+
+    constexpr bool is_over() const { return legal_moves_mask() == 0; }
+
+    constexpr int get_tile(int x, int y) const {
+        const int exponent = cells[pos2n(x, y)];
+        return exponent ? 1 << exponent : 0;
+    }
+
+    constexpr void set_tile(int x, int y, int val) {
+        cells[pos2n(x, y)] =
+            uint8_t(val ? std::countr_zero(unsigned(val)) : 0);
+    }
+
+    constexpr int count_tiles() const {
+        int cnt = 0;
+        for (auto e : cells) {
+            cnt += e != 0;
+        }
+        return cnt;
+    }
+
+    constexpr int count_empty_tiles() const { return CELLS - count_tiles(); }
+
+    constexpr int count_distinct_tiles() const {
+        uint64_t mask = 0;
+        for (auto e : cells) {
+            if (e) {
+                mask |= 1ULL << e;
+            }
+        }
+        return std::popcount(mask);
+    }
+
+    static constexpr int size() { return N; }
+
+    uint64_t hash() const {
+        uint64_t h = N;
+        for (int i = 0; i < CELLS; i += 8) {
+            uint64_t word = 0;
+            std::memcpy(&word, cells.data() + i, std::min(8, CELLS - i));
+            h = fmix64(h ^ word);
+        }
+        return h;
+    }
+
+    constexpr bool operator==(const board_t& brd) const {
+        return cells == brd.cells;
+    }
+
+    constexpr uint64_t get_score() const { return score; }
+
+   private:
+    std::array<uint8_t, CELLS> cells{};
+    uint64_t score = 0;
+
+    static constexpr int pos2n(int x, int y) { return x * N + y; }
+
+    // index of the j-th cell of `line`, counted from the side tiles move to
+    static constexpr int line_pos(int dir, int line, int j) {
+        switch (dir) {
+            case direction::down:
+                return pos2n(N - 1 - j, line);
+            case direction::right:
+                return pos2n(line, N - 1 - j);
+            case direction::up:
+                return pos2n(j, line);
+            default:
+                return pos2n(line, j);
+        }
+    }
+
+    // Dir is a template argument so line_pos folds to constant offsets
+    template <int Dir>
+    constexpr void move_lines() {
+        for (int i = 0; i < N; ++i) {
+            // packed in a register, a column is not stored byte by byte
+            // only to be loaded as a word
+            uint64_t line = 0;
+            for (int j = 0; j < N; ++j) {
+                line |= uint64_t(cells[line_pos(Dir, i, j)]) << (8 * j);
+            }
+            score += row_kernel::slide_and_merge(line);
+            for (int j = 0; j < N; ++j) {
+                cells[line_pos(Dir, i, j)] = uint8_t(line >> (8 * j));
+            }
+        }
+    }
+
+    template <int Dir>
+    constexpr bool can_move_lines() const {
+        for (int i = 0; i < N; ++i) {
+            for (int j = 0; j + 1 < N; ++j) {
+                const int front = cells[line_pos(Dir, i, j)];
+                const int back = cells[line_pos(Dir, i, j + 1)];
+                if (back != 0 && (front == 0 || front == back)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // directions enabled by `front` and its neighbour `back`
+    static constexpr int pair_mask(int front, int back, int towards_front,
+                                   int towards_back) {
+        if (front != 0 && front == back) {
+            return (1 << towards_front) | (1 << towards_back);
+        } else if (front == 0 && back != 0) {
+            return 1 << towards_front;
+        } else if (front != 0 && back == 0) {
+            return 1 << towards_back;
+        }
+        return 0;
+    }
+};
+
+// Calls `f` with `board` converted to the fastest representation for its
+// size: the packed bitboard for 4x4, board_t<N> for sizes 3 to 8, and the
+// runtime-sized board_2048 itself otherwise.
+template <typename F>
+decltype(auto) dispatch_board(const board_2048& board, F&& f) {
+    switch (board.size()) {
+        case 3:
+            return f(board_t<3>(board));
+        case 4:
+            if (bitboard::fits(board)) {
+                return f(bitboard(board));
+            }
+            return f(board_t<4>(board));
+        case 5:
+            return f(board_t<5>(board));
+        case 6:
+            return f(board_t<6>(board));
+        case 7:
+            return f(board_t<7>(board));
+        case 8:
+            return f(board_t<8>(board));
+        default:
+            return f(board);
+    }
+}
+}  // namespace core
+template <int N>
+struct std::hash<core::board_t<N>> {
+    uint64_t operator()(const core::board_t<N>& brd) const {
+        return brd.hash();
+    }
+};
@@ -0,0 +1,17 @@
+#pragma once
+#include "bitboard.hpp"
+
+namespace core {
+// Leaf evaluation plugged into the solver (solver::set_evaluator) in place
+// of the built-in corner heuristic, for boards searched as bitboards. The
+// value is the score still to come from the position; the solver adds the
+// score of the moves leading to each leaf. Search threads call it
+// concurrently and the cache shares entries between mirrored and rotated
+// positions, so it must be thread-safe and give every image the same value.
+class evaluator {
+   public:
+    virtual ~evaluator() = default;
+
+    virtual double evaluate(const bitboard& board) const = 0;
+};
+}  // namespace core
@@ -0,0 +1,135 @@
+#pragma once
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "board_2048.hpp"
+#include "game_record.hpp"
+
+namespace core {
+// Undo and redo over a game. Moves are kept as a delta log in the encoding
+// of game_record, a byte or two each, and the board is packed one byte per
+// cell every SNAPSHOT_INTERVAL moves, so going back replays fewer than
+// SNAPSHOT_INTERVAL moves from the snapshot behind. Moves undone stay in
+// the log for redo until another move is played.
+//
+// Each position also keeps the solver's cache generation when it was
+// reached (solver::get_cache_generation): restoring it with the position
+// makes the results searched there fresh again.
+class game_history {
+   public:
+    static constexpr int SNAPSHOT_INTERVAL = 32;
+
+    explicit game_history(const board_2048& board, int generation = 0)
+        : cells(board.size() * board.size()) {
+        snapshot(board);
+        generations.push_back(uint8_t(generation));
+    }
+
+    // Moves played to reach the current position.
+    int position() const { return current; }
+
+    // Moves in the log, including those undone.
+    int size() const { return int(generations.size()) - 1; }
+
+    bool can_undo() const { return current > 0; }
+
+    bool can_redo() const { return current < size(); }
+
+    // Cache generation of the current position.
+    int generation() const { return generations[size_t(current)]; }
+
+    // The move `dir` played from the current position, which led to `board`
+    // once `tile` spawned at `cell`, with the cache at `generation` then.
+    // Drops the moves undone.
+    void push(const board_2048& board, int dir, int cell, int tile,
+              int generation) {
+        truncate();
+        game_record::put_varint(log, game_record::encode(dir, cell, tile));
+        generations.push_back(uint8_t(generation));
+        ++current;
+        offset = log.size();
+        if (current % SNAPSHOT_INTERVAL == 0) {
+            snapshot(board);
+        }
+    }
+
+    // Sets `board`, which is at the current position, to the position after
+    // `position` moves of the log. False if there is no such position.
+    bool seek(int position, board_2048& board) {
+        if (position < 0 || position > size()) {
+            return false;
+        }
+        const int key = position / SNAPSHOT_INTERVAL;
+        if (position < current || current < key * SNAPSHOT_INTERVAL) {
+            restore(key, board);
+        }
+        const uint8_t* data = log.data();
+        while (current < position) {
+            uint32_t code;
+            offset = size_t(game_record::get_varint(
+                                data + offset, data + log.size(), code) -
+                            data);
+            game_view::play(board, game_record::decode(code));
+            ++current;
+        }
+        return true;
+    }
+
+    bool undo(board_2048& board) { return seek(current - 1, board); }
+
+    bool redo(board_2048& board) { return seek(current + 1, board); }
+
+    // Bytes held by the log and the snapshots.
+    size_t memory() const {
+        return log.capacity() + generations.capacity() + packed.capacity() +
+               scores.capacity() * sizeof(uint64_t) +
+               offsets.capacity() * sizeof(size_t);
+    }
+
+   private:
+    int cells;
+    std::vector<uint8_t> log;
+    std::vector<uint8_t> generations;  // per position
+    std::vector<uint8_t> packed;       // per snapshot, the log2 of each tile
+    std::vector<uint64_t> scores;      // per snapshot
+    std::vector<size_t> offsets;       // per snapshot, where its moves start
+    int current = 0;
+    size_t offset = 0;  // in `log`, of the current position
+
+    void snapshot(const board_2048& board) {
+        for (int cell = 0; cell < cells; ++cell) {
+            const int tile =
+                board.get_tile(cell / board.size(), cell % board.size());
+            packed.push_back(
+                uint8_t(tile == 0 ? 0 : std::countr_zero(unsigned(tile))));
+        }
+        scores.push_back(board.get_score());
+        offsets.push_back(log.size());
+    }
+
+    void restore(int key, board_2048& board) {
+        const uint8_t* tiles = packed.data() + size_t(key) * size_t(cells);
+        for (int cell = 0; cell < cells; ++cell) {
+            board.set_tile(cell / board.size(), cell % board.size(),
+                           tiles[cell] == 0 ? 0 : 1 << tiles[cell]);
+        }
+        board.set_score(scores[size_t(key)]);
+        current = key * SNAPSHOT_INTERVAL;
+        offset = offsets[size_t(key)];
+    }
+
+    void truncate() {
+        if (current == size()) {
+            return;
+        }
+        log.resize(offset);
+        generations.resize(size_t(current) + 1);
+        const size_t kept = size_t(current / SNAPSHOT_INTERVAL) + 1;
+        packed.resize(kept * size_t(cells));
+        scores.resize(kept);
+        offsets.resize(kept);
+    }
+};
+}  // namespace core
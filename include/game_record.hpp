@@ -0,0 +1,549 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "board_2048.hpp"
+#include "mapped_file.hpp"
+
+namespace core {
+// The move played and the tile that spawned after it.
+struct recorded_move {
+    int dir;
+    int cell;  // x * size + y
+    int tile;  // 2 or 4
+};
+
+// One game kept move by move, encoded in memory as in a record file.
+//
+// File layout, native byte order: the 8-byte MAGIC, then games, each a
+// 48-byte header and `bytes` bytes of tiles and moves. First come the
+// header's start_tiles tiles of the starting board, each its cell as a
+// varint and the log2 of the tile in one byte, then per move the varint of
+// (cell * 2 + (tile == 4)) * 4 + dir. Varints hold 7 bits per byte, low
+// bits first, with the high bit set on all but the last byte: a move takes
+// one byte on 4x4 and two on boards up to 45x45.
+class game_record {
+   public:
+    static constexpr char MAGIC[8] = {'2', '0', '4', '8', 'G', 'R', 'C', '2'};
+    // largest board size a reader accepts
+    static constexpr int MAX_BOARD_SIZE = 256;
+    // `bytes` of a game still being written by record_writer::begin
+    static constexpr uint32_t UNFINISHED = ~uint32_t(0);
+
+    struct header {
+        uint64_t seed;      // of the spawns, when recording started
+        uint64_t settings;  // solver::settings_fingerprint(), 0 by hand
+        uint64_t score;     // when the game ended
+        uint64_t start_score;  // of the starting board, 0 for a new game
+        uint32_t bytes;     // of the tiles and moves that follow
+        uint32_t moves;
+        uint16_t board_size;
+        uint16_t start_tiles;
+        int32_t depth;  // the solver's depth setting, 0 by hand
+    };
+    static_assert(sizeof(header) == 48);
+
+    // Starts from the tiles and score of `board`.
+    explicit game_record(const board_2048& board, uint64_t seed = 0,
+                         uint64_t settings = 0, int depth = 0)
+        : head{seed, settings, 0, board.get_score(), 0, 0,
+               uint16_t(board.size()), 0, depth} {
+        for (int cell = 0; cell < board.size() * board.size(); ++cell) {
+            const int tile = board.get_tile(cell / board.size(),
+                                            cell % board.size());
+            if (tile != 0) {
+                put_varint(data, uint32_t(cell));
+                data.push_back(uint8_t(std::countr_zero(unsigned(tile))));
+                ++head.start_tiles;
+            }
+        }
+        head.bytes = uint32_t(data.size());
+    }
+
+    void add(int dir, int cell, int tile) {
+        put_varint(data, encode(dir, cell, tile));
+        head.bytes = uint32_t(data.size());
+        ++head.moves;
+    }
+
+    void finish(uint64_t score) { head.score = score; }
+
+    const header& info() const { return head; }
+
+    const std::vector<uint8_t>& bytes() const { return data; }
+
+    static uint32_t encode(int dir, int cell, int tile) {
+        return (uint32_t(cell) * 2 + (tile == 4 ? 1 : 0)) * 4 + uint32_t(dir);
+    }
+
+    static recorded_move decode(uint32_t code) {
+        return {int(code & 3), int(code >> 3), (code & 4) ? 4 : 2};
+    }
+
+    // Whether `move` can be played on a `size` board: the direction and
+    // tile are always in range once decoded, the cell may not be.
+    static bool valid(const recorded_move& move, int size) {
+        return move.dir >= 0 && move.dir < 4 && move.cell >= 0 &&
+               move.cell < size * size && (move.tile == 2 || move.tile == 4);
+    }
+
+    // Whether `info` describes a game a reader can hold.
+    static bool valid(const header& info) {
+        return info.board_size >= 2 && info.board_size <= MAX_BOARD_SIZE &&
+               info.start_tiles <= info.board_size * info.board_size;
+    }
+
+    static void put_varint(std::vector<uint8_t>& out, uint32_t value) {
+        while (value >= 0x80) {
+            out.push_back(uint8_t(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(uint8_t(value));
+    }
+
+    // Reads a varint from [p, end) and returns the byte after it, nullptr
+    // if it is cut short.
+    static const uint8_t* get_varint(const uint8_t* p, const uint8_t* end,
+                                     uint32_t& value) {
+        value = 0;
+        for (int shift = 0; p != end && shift < 35; shift += 7) {
+            const uint8_t byte = *p++;
+            value |= uint32_t(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return p;
+            }
+        }
+        return nullptr;
+    }
+
+    // The first move after `count` start tiles from `p`, nullptr if they
+    // are cut short.
+    static const uint8_t* skip_tiles(const uint8_t* p, const uint8_t* end,
+                                     int count) {
+        for (int t = 0; t < count && p; ++t) {
+            uint32_t cell;
+            p = get_varint(p, end, cell);
+            p = p && p != end ? p + 1 : nullptr;
+        }
+        return p;
+    }
+
+   private:
+    header head;
+    std::vector<uint8_t> data;
+};
+
+// A recorded game as stored in a mapped record file; decodes on demand.
+class game_view {
+   public:
+    game_view(const game_record::header& head, const uint8_t* begin,
+              const uint8_t* end)
+        : head(head), begin(begin), end(end) {}
+
+    const game_record::header& info() const { return head; }
+
+    int size() const { return head.board_size; }
+
+    int moves() const { return int(head.moves); }
+
+    // The starting board and score, spawning from the recorded seed.
+    board_2048 start() const {
+        board_2048 board(size(), head.seed);
+        board.set_score(head.start_score);
+        for (int cell = 0; cell < size() * size(); ++cell) {
+            board.set_tile(cell / size(), cell % size(), 0);
+        }
+        const uint8_t* p = begin;
+        for (int t = 0; t < head.start_tiles; ++t) {
+            uint32_t cell;
+            p = game_record::get_varint(p, end, cell);
+            if (!p || p == end) {
+                break;
+            }
+            const int exponent = *p++;
+            if (cell < uint32_t(size() * size()) && exponent < 31) {
+                board.set_tile(int(cell) / size(), int(cell) % size(),
+                               1 << exponent);
+            }
+        }
+        return board;
+    }
+
+    // Steps through the moves in order.
+    class cursor {
+       public:
+        // The next move, false after the last or at one that is cut short
+        // or can't be played, which sets corrupt().
+        bool next(recorded_move& move) {
+            uint32_t code;
+            if (remaining == 0 || broken) {
+                return false;
+            }
+            p = game_record::get_varint(p, end, code);
+            if (!p || !game_record::valid(game_record::decode(code), size)) {
+                broken = true;
+                return false;
+            }
+            --remaining;
+            move = game_record::decode(code);
+            return true;
+        }
+
+        // Whether the moves ended early on bad data.
+        bool corrupt() const { return broken; }
+
+       private:
+        friend class game_view;
+        cursor(const uint8_t* p, const uint8_t* end, int remaining, int size)
+            : p(p), end(end), remaining(remaining), size(size),
+              broken(!p && remaining > 0) {}
+        const uint8_t* p;
+        const uint8_t* end;
+        int remaining;
+        int size;
+        bool broken;
+    };
+
+    cursor moves_cursor() const {
+        const uint8_t* p =
+            game_record::skip_tiles(begin, end, head.start_tiles);
+        return cursor(p, end, moves(), size());
+    }
+
+    // The board after the first `count` moves, or after the last good one
+    // if the record is corrupt before.
+    board_2048 board_at(int count) const {
+        board_2048 board = start();
+        cursor moves = moves_cursor();
+        recorded_move move;
+        for (int i = 0; i < count && moves.next(move); ++i) {
+            play(board, move);
+        }
+        return board;
+    }
+
+    static void play(board_2048& board, const recorded_move& move) {
+        board.move(move.dir);
+        board.set_tile(move.cell / board.size(), move.cell % board.size(),
+                       move.tile);
+    }
+
+   private:
+    game_record::header head;
+    const uint8_t* begin;
+    const uint8_t* end;
+};
+
+// Random access to the positions of a recorded game: a snapshot every
+// `interval` moves bounds any seek to replaying fewer than `interval` moves.
+// Holds the game decoded, so the file may be closed once it is built.
+class game_replay {
+   public:
+    static constexpr int KEYFRAME_INTERVAL = 64;
+
+    // Throws std::runtime_error if a move is cut short, out of the board
+    // or spawns on a tile.
+    explicit game_replay(const game_view& game,
+                         int interval = KEYFRAME_INTERVAL)
+        : interval(std::max(1, interval)), current(game.start()) {
+        board_2048 board = current;
+        keyframes.push_back(board);
+        // a move takes a byte at least, whatever the header claims
+        moves.reserve(std::min<size_t>(game.moves(), game.info().bytes));
+        game_view::cursor cursor = game.moves_cursor();
+        recorded_move move;
+        while (cursor.next(move)) {
+            board.move(move.dir);
+            if (board.get_tile(move.cell / board.size(),
+                               move.cell % board.size()) != 0) {
+                throw std::runtime_error(
+                    "corrupt game record: move " +
+                    std::to_string(moves.size() + 1) + " spawns on a tile");
+            }
+            board.set_tile(move.cell / board.size(),
+                           move.cell % board.size(), move.tile);
+            moves.push_back(move);
+            if (moves.size() % size_t(this->interval) == 0) {
+                keyframes.push_back(board);
+            }
+        }
+        if (cursor.corrupt()) {
+            throw std::runtime_error("corrupt game record: move " +
+                                     std::to_string(moves.size() + 1) +
+                                     " is cut short or off the board");
+        }
+    }
+
+    // Moves in the game.
+    int size() const { return int(moves.size()); }
+
+    // Moves played to reach board().
+    int index() const { return position; }
+
+    const board_2048& board() const { return current; }
+
+    const recorded_move& move(int i) const { return moves[size_t(i)]; }
+
+    // Goes to the position after `index` moves, clamped to the game.
+    void seek(int index) {
+        index = std::clamp(index, 0, size());
+        const int key = index / interval;
+        if (index < position || position < key * interval) {
+            current = keyframes[size_t(key)];
+            position = key * interval;
+        }
+        while (position < index) {
+            game_view::play(current, moves[size_t(position++)]);
+        }
+    }
+
+    // Plays the next move, appending where the tiles went to `tile_moves`
+    // as board_2048::move does. False at the end of the game.
+    bool step(std::vector<tile_move>& tile_moves) {
+        if (position == size()) {
+            return false;
+        }
+        const recorded_move& next = moves[size_t(position++)];
+        current.move(next.dir, tile_moves);
+        current.set_tile(next.cell / current.size(),
+                         next.cell % current.size(), next.tile);
+        return true;
+    }
+
+   private:
+    int interval;
+    std::vector<recorded_move> moves;
+    std::vector<board_2048> keyframes;  // after 0, interval, 2 * interval...
+    board_2048 current;
+    int position = 0;
+};
+
+// All games of a record file, mapped read-only: opening it reads only the
+// game headers, so games are found in O(1) and their moves read on demand.
+// A game cut short, by a crash or because the file is being written, ends
+// the list, except that the moves of a game still being streamed count up
+// to the last complete one.
+class record_reader {
+   public:
+    // Throws std::runtime_error if the file can't be read or isn't a record
+    // file.
+    explicit record_reader(const std::string& path) : file(path) {
+        const auto* data = reinterpret_cast<const uint8_t*>(file.data());
+        const size_t size = file.size();
+        if (size < sizeof(game_record::MAGIC) ||
+            std::memcmp(data, game_record::MAGIC,
+                        sizeof(game_record::MAGIC))) {
+            throw std::runtime_error(path + " is not a game record file");
+        }
+        size_t offset = sizeof(game_record::MAGIC);
+        while (offset + sizeof(game_record::header) <= size) {
+            game_record::header info;
+            std::memcpy(&info, data + offset, sizeof(info));
+            const size_t payload = offset + sizeof(info);
+            if (!game_record::valid(info)) {
+                break;
+            }
+            if (info.bytes == game_record::UNFINISHED) {
+                games.push_back({offset, complete_part(info, data + payload,
+                                                       data + size)});
+                break;
+            }
+            if (info.bytes > size - payload) {
+                break;
+            }
+            games.push_back({offset, info});
+            offset = payload + info.bytes;
+        }
+    }
+
+    size_t size() const { return games.size(); }
+
+    game_view operator[](size_t i) const {
+        const auto* data = reinterpret_cast<const uint8_t*>(file.data());
+        const uint8_t* begin =
+            data + games[i].offset + sizeof(game_record::header);
+        return game_view(games[i].info, begin, begin + games[i].info.bytes);
+    }
+
+    // Bytes of the complete games and moves.
+    size_t complete_size() const {
+        return games.empty() ? sizeof(game_record::MAGIC)
+                             : games.back().offset +
+                                   sizeof(game_record::header) +
+                                   games.back().info.bytes;
+    }
+
+    // Whether the last game was still being written.
+    bool last_unfinished() const { return unfinished; }
+
+   private:
+    struct entry {
+        size_t offset;
+        game_record::header info;
+    };
+
+    mapped_file file;
+    std::vector<entry> games;
+    bool unfinished = false;
+
+    // The header of a game being streamed, with `bytes` and `moves` up to
+    // the last complete and valid move and the score reached by then.
+    game_record::header complete_part(game_record::header info,
+                                      const uint8_t* begin,
+                                      const uint8_t* end) {
+        unfinished = true;
+        const uint8_t* p =
+            game_record::skip_tiles(begin, end, info.start_tiles);
+        info.moves = 0;
+        info.bytes = 0;
+        if (p) {
+            info.bytes = uint32_t(p - begin);
+            uint32_t code;
+            while ((p = game_record::get_varint(p, end, code)) &&
+                   game_record::valid(game_record::decode(code),
+                                      info.board_size)) {
+                ++info.moves;
+                info.bytes = uint32_t(p - begin);
+            }
+        }
+        info.score =
+            game_view(info, begin, begin + info.bytes).board_at(info.moves)
+                .get_score();
+        return info;
+    }
+};
+
+// Appends games to a record file, whole or streamed move by move. One
+// writer per file at a time.
+class record_writer {
+   public:
+    // Opens the file at `path` for appending, creating it if needed; a game
+    // left unfinished by a crash is closed with the moves it has. Throws
+    // std::runtime_error if it can't be written or isn't a record file.
+    explicit record_writer(const std::string& path) : path(path) {
+        if (!std::filesystem::exists(path) ||
+            std::filesystem::file_size(path) == 0) {
+            std::ofstream create(path, std::ios::binary | std::ios::trunc);
+            create.write(game_record::MAGIC, sizeof(game_record::MAGIC));
+            if (!create) {
+                throw std::runtime_error("cannot write " + path);
+            }
+        } else {
+            size_t complete;
+            game_record::header last{};
+            size_t last_offset = 0;
+            {
+                const record_reader existing(path);
+                complete = existing.complete_size();
+                if (existing.last_unfinished()) {
+                    last = existing[existing.size() - 1].info();
+                    last_offset = complete - sizeof(last) - last.bytes;
+                }
+            }
+            std::filesystem::resize_file(path, complete);
+            if (last.board_size != 0) {
+                std::fstream repair(path,
+                                    std::ios::binary | std::ios::in |
+                                        std::ios::out);
+                repair.seekp(std::streamoff(last_offset));
+                repair.write(reinterpret_cast<const char*>(&last),
+                             sizeof(last));
+            }
+        }
+        out.open(path, std::ios::binary | std::ios::in | std::ios::out);
+        out.seekp(0, std::ios::end);
+        if (!out) {
+            throw std::runtime_error("cannot write " + path);
+        }
+    }
+
+    record_writer(const record_writer&) = delete;
+    record_writer& operator=(const record_writer&) = delete;
+
+    // Appends a finished game. Thread-safe; not while a game is streamed.
+    void write(const game_record& game) {
+        std::lock_guard lock(mtx);
+        put(game.info(), game.bytes());
+    }
+
+    // Streams `game` and the moves added after it, each on disk once
+    // added, until end(). A game not ended is left unfinished, as by a
+    // crash. Ends the game streamed before, if any.
+    void begin(const game_record& game) {
+        std::lock_guard lock(mtx);
+        if (streamed_offset != -1) {
+            finish_streamed(streamed.score);
+        }
+        streamed = game.info();
+        streamed_offset = std::streamoff(out.tellp());
+        game_record::header marked = streamed;
+        marked.bytes = game_record::UNFINISHED;
+        put(marked, game.bytes());
+    }
+
+    void add(int dir, int cell, int tile) {
+        std::lock_guard lock(mtx);
+        if (streamed_offset == -1) {
+            return;
+        }
+        buffer.clear();
+        game_record::put_varint(buffer, game_record::encode(dir, cell, tile));
+        out.write(reinterpret_cast<const char*>(buffer.data()),
+                  std::streamsize(buffer.size()));
+        out.flush();
+        streamed.bytes += uint32_t(buffer.size());
+        ++streamed.moves;
+        check();
+    }
+
+    // Closes the streamed game with its final score.
+    void end(uint64_t score) {
+        std::lock_guard lock(mtx);
+        if (streamed_offset != -1) {
+            finish_streamed(score);
+        }
+    }
+
+   private:
+    std::string path;
+    std::fstream out;
+    std::mutex mtx;
+    game_record::header streamed{};
+    std::streamoff streamed_offset = -1;
+    std::vector<uint8_t> buffer;
+
+    void put(const game_record::header& info,
+             const std::vector<uint8_t>& bytes) {
+        out.write(reinterpret_cast<const char*>(&info), sizeof(info));
+        out.write(reinterpret_cast<const char*>(bytes.data()),
+                  std::streamsize(bytes.size()));
+        out.flush();
+        check();
+    }
+
+    void finish_streamed(uint64_t score) {
+        streamed.score = score;
+        const std::streampos at = out.tellp();
+        out.seekp(streamed_offset);
+        out.write(reinterpret_cast<const char*>(&streamed), sizeof(streamed));
+        out.seekp(at);
+        out.flush();
+        streamed_offset = -1;
+        check();
+    }
+
+    void check() {
+        if (!out) {
+            throw std::runtime_error("cannot write " + path);
+        }
+    }
+};
+}  // namespace core
@@ -0,0 +1,15 @@
+#pragma once
+#include <cstdint>
+
+namespace core {
+// murmur3 64-bit finalizer: spreads every input bit over the whole word, so
+// packed boards can be used directly as hash table indices.
+constexpr uint64_t fmix64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+}  // namespace core
@@ -0,0 +1,70 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+
+namespace core {
+// Weight solver::evaluate_board gives a tile `i` rows and `j` columns away
+// from the corner being scored: 20 in the corner, halved (rounding down) for
+// every row, then halved along the row but never below 1, on the triangle
+// j < size - i only. A closed form of the original nested loops.
+constexpr int corner_weight(int size, int i, int j) {
+    if (j >= size - i) {
+        return 0;
+    }
+    const int row_weight = i < 31 ? 20 >> i : 0;
+    return j == 0 ? row_weight : std::max(1, row_weight >> std::min(j, 31));
+}
+
+// Whether corner_weight is unchanged with i and j swapped, so that the
+// evaluation is also unchanged by transposing the board. Off the first
+// column both are max(1, 20 >> (i + j)), but from size 6 on the first
+// column reaches 0 at row 5 while the first row stays at 1.
+constexpr bool corner_weights_symmetric(int size) { return size <= 5; }
+
+template <int N>
+constexpr std::array<std::array<int, N>, N> make_corner_weights() {
+    std::array<std::array<int, N>, N> weights{};
+    for (int i = 0; i < N; ++i) {
+        for (int j = 0; j < N; ++j) {
+            weights[i][j] = corner_weight(N, i, j);
+        }
+    }
+    return weights;
+}
+
+template <int N>
+inline constexpr auto corner_weights = make_corner_weights<N>();
+
+// Weighted sums of packed 4x4 rows (four 4-bit exponents, cell 0 in the low
+// nibble): sum[i][row] is what `row` contributes when it is the i-th row
+// away from the scored corner, counting columns from cell 0. The other
+// orientations read the reversed row or the mirrored row index.
+struct eval_row_table {
+    static constexpr int ROW_SIZE = 4;
+    static constexpr int ROWS = 1 << 16;
+
+    uint32_t sum[ROW_SIZE][ROWS];
+
+    eval_row_table() {
+        for (int i = 0; i < ROW_SIZE; ++i) {
+            for (int row = 0; row < ROWS; ++row) {
+                uint32_t value = 0;
+                for (int j = 0; j < ROW_SIZE; ++j) {
+                    if (int e = (row >> (4 * j)) & 0xF) {
+                        value += uint32_t(corner_weights<ROW_SIZE>[i][j]) << e;
+                    }
+                }
+                sum[i][row] = value;
+            }
+        }
+    }
+};
+
+inline const eval_row_table& eval_row_tables() {
+    static const std::unique_ptr<const eval_row_table> table =
+        std::make_unique<const eval_row_table>();
+    return *table;
+}
+}  // namespace core
@@ -0,0 +1,97 @@
+#pragma once
+#include <cstddef>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CORE_HAS_MMAP 1
+#else
+#define CORE_HAS_MMAP 0
+#endif
+
+namespace core {
+// Read-only view of a whole file: memory-mapped where the platform has mmap,
+// so pages load on first touch and are shared between processes, and read
+// into memory otherwise. Throws std::runtime_error if the file can't be read.
+class mapped_file {
+   public:
+    mapped_file() = default;
+
+    explicit mapped_file(const std::string& path) {
+#if CORE_HAS_MMAP
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("cannot open " + path);
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("cannot stat " + path);
+        }
+        length = size_t(st.st_size);
+        if (length > 0) {
+            void* addr = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+            if (addr == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("cannot map " + path);
+            }
+            bytes = static_cast<const std::byte*>(addr);
+        }
+        ::close(fd);  // the mapping keeps the file alive
+#else
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in) {
+            throw std::runtime_error("cannot open " + path);
+        }
+        buffer.resize(size_t(in.tellg()));
+        in.seekg(0);
+        if (!in.read(reinterpret_cast<char*>(buffer.data()), buffer.size())) {
+            throw std::runtime_error("cannot read " + path);
+        }
+        bytes = buffer.data();
+        length = buffer.size();
+#endif
+    }
+
+    mapped_file(mapped_file&& other) noexcept { swap(other); }
+
+    mapped_file& operator=(mapped_file&& other) noexcept {
+        mapped_file(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    ~mapped_file() {
+#if CORE_HAS_MMAP
+        if (bytes) {
+            ::munmap(const_cast<std::byte*>(bytes), length);
+        }
+#endif
+    }
+
+    const std::byte* data() const { return bytes; }
+
+    size_t size() const { return length; }
+
+   private:
+    const std::byte* bytes = nullptr;
+    size_t length = 0;
+#if !CORE_HAS_MMAP
+    std::vector<std::byte> buffer;
+#endif
+
+    void swap(mapped_file& other) noexcept {
+        std::swap(bytes, other.bytes);
+        std::swap(length, other.length);
+#if !CORE_HAS_MMAP
+        std::swap(buffer, other.buffer);
+#endif
+    }
+};
+}  // namespace core
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+
+namespace core {
+// Lookup tables for moving a 4-cell row packed as four 4-bit log2 exponents
+// (cell 0 in the low nibble). Every possible row is precomputed once, so a
+// move costs one lookup per row instead of slide / merge / slide.
+struct row_table {
+    static constexpr int ROW_SIZE = 4;
+    static constexpr int ROWS = 1 << 16;
+    static constexpr int MAX_EXPONENT = 15;
+
+    uint16_t left[ROWS];   // row moved towards cell 0
+    uint16_t right[ROWS];  // row moved towards cell 3
+    uint32_t score[ROWS];  // gain of the left move, the right move of the
+                           // reversed row gains the same
+
+    row_table() {
+        for (int row = 0; row < ROWS; ++row) {
+            uint32_t gain = 0;
+            left[row] = move_row_left(uint16_t(row), gain);
+            score[row] = gain;
+            const uint16_t rev = reverse_row(uint16_t(row));
+            right[rev] = reverse_row(left[row]);
+        }
+    }
+
+    static constexpr uint16_t reverse_row(uint16_t row) {
+        return uint16_t((row >> 12) | ((row >> 4) & 0x00F0) |
+                        ((row << 4) & 0x0F00) | (row << 12));
+    }
+
+    // same merging rule as board_2048::move;
+    // exponent 15 cannot grow, so two 32768 tiles are left alone
+    static constexpr uint16_t move_row_left(uint16_t row, uint32_t& gain) {
+        int line[ROW_SIZE] = {};
+        int n = 0;
+        for (int i = 0; i < ROW_SIZE; ++i) {
+            if (int e = (row >> (4 * i)) & 0xF) {
+                line[n++] = e;
+            }
+        }
+        uint16_t ret = 0;
+        int out = 0;
+        for (int i = 0; i < n; ++i) {
+            int e = line[i];
+            if (i + 1 < n && e == line[i + 1] && e < MAX_EXPONENT) {
+                ++e;
+                gain += 1U << e;
+                ++i;
+            }
+            ret |= uint16_t(e << (4 * out++));
+        }
+        return ret;
+    }
+};
+
+inline const row_table& row_tables() {
+    static const std::unique_ptr<const row_table> table =
+        std::make_unique<const row_table>();
+    return *table;
+}
+}  // namespace core
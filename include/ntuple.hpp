@@ -0,0 +1,236 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bitboard.hpp"
+#include "evaluator.hpp"
+#include "mapped_file.hpp"
+#include "symmetry.hpp"
+
+namespace core {
+// N-tuple network over 4x4 bitboards. Each tuple is a handful of cells
+// whose exponents, read as one number, index a table of weights; the value
+// of a board is the sum over all tuples placed on all eight symmetric images
+// of the board, which share weights, so it is symmetric by construction.
+// Values estimate the score still to come from an afterstate (the board
+// right after a move, before the spawn), as learned by 2048-train.
+//
+// File layout, native (little-endian) byte order: the 8-byte MAGIC, the
+// board size and the tuple count as uint32, then per tuple a uint32 length
+// and 12 bytes of cells (x * 4 + y); from the next multiple of 64 bytes,
+// each tuple's 16^length float weights in turn.
+class ntuple_network : public evaluator {
+   public:
+    using shape = std::vector<int>;
+    static constexpr int SIZE = bitboard::brd_size;
+    static constexpr int MAX_TUPLE = 6;
+    static constexpr char MAGIC[8] = {'2', '0', '4', '8', 'N', 'T', 'N', '1'};
+
+    // Two lines and three squares of four cells; 1.3 MB of weights.
+    static std::vector<shape> four_tuples() {
+        return {{0, 1, 2, 3},
+                {4, 5, 6, 7},
+                {0, 1, 4, 5},
+                {1, 2, 5, 6},
+                {5, 6, 9, 10}};
+    }
+
+    // The usual four 6-tuples; 256 MB of weights, much stronger once
+    // trained.
+    static std::vector<shape> six_tuples() {
+        return {{0, 1, 2, 3, 4, 5},
+                {4, 5, 6, 7, 8, 9},
+                {0, 1, 2, 4, 5, 6},
+                {4, 5, 6, 8, 9, 10}};
+    }
+
+    // All-zero weights held in memory, to be trained. Throws
+    // std::invalid_argument for tuples that are empty, too long or repeat
+    // or leave the board's cells.
+    explicit ntuple_network(std::vector<shape> tuple_shapes)
+        : shapes(std::move(tuple_shapes)) {
+        layout();
+        owned = std::make_unique<float[]>(weight_count);
+        weights = owned.get();
+    }
+
+    // Copy in memory, e.g. to keep training a loaded network.
+    ntuple_network(const ntuple_network& other)
+        : ntuple_network(other.shapes) {
+        std::copy_n(other.weights, weight_count, owned.get());
+    }
+
+    ntuple_network& operator=(const ntuple_network&) = delete;
+
+    // Maps the weights of a file written by save() read-only. Throws
+    // std::runtime_error if it can't be read or isn't such a file.
+    static std::shared_ptr<ntuple_network> load(const std::string& path) {
+        mapped_file file(path);
+        const std::byte* data = file.data();
+        const size_t size = file.size();
+        const auto malformed = [&path] {
+            return std::runtime_error(path + " is not an n-tuple network");
+        };
+        uint32_t header[2];  // board size, tuple count
+        if (size < HEADER_BYTES || std::memcmp(data, MAGIC, sizeof(MAGIC))) {
+            throw malformed();
+        }
+        std::memcpy(header, data + sizeof(MAGIC), sizeof(header));
+        if (header[0] != SIZE || size < weights_offset(header[1])) {
+            throw malformed();
+        }
+        std::vector<shape> shapes(header[1]);
+        for (uint32_t t = 0; t < header[1]; ++t) {
+            const std::byte* entry = data + HEADER_BYTES + t * TUPLE_BYTES;
+            uint32_t length;
+            std::memcpy(&length, entry, sizeof(length));
+            if (length > MAX_TUPLE) {
+                throw malformed();
+            }
+            for (uint32_t k = 0; k < length; ++k) {
+                shapes[t].push_back(int(entry[sizeof(length) + k]));
+            }
+        }
+        std::shared_ptr<ntuple_network> network(new ntuple_network);
+        network->shapes = std::move(shapes);
+        try {
+            network->layout();
+        } catch (const std::invalid_argument&) {
+            throw malformed();
+        }
+        const size_t offset = weights_offset(network->shapes.size());
+        if (size != offset + network->weight_count * sizeof(float)) {
+            throw std::runtime_error(path + " is truncated");
+        }
+        network->weights = reinterpret_cast<const float*>(data + offset);
+        network->file = std::move(file);
+        return network;
+    }
+
+    // Throws std::runtime_error if the file can't be written.
+    void save(const std::string& path) const {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        std::vector<char> head(weights_offset(shapes.size()), 0);
+        std::memcpy(head.data(), MAGIC, sizeof(MAGIC));
+        const uint32_t header[2] = {SIZE, uint32_t(shapes.size())};
+        std::memcpy(head.data() + sizeof(MAGIC), header, sizeof(header));
+        for (size_t t = 0; t < shapes.size(); ++t) {
+            char* entry = head.data() + HEADER_BYTES + t * TUPLE_BYTES;
+            const uint32_t length = uint32_t(shapes[t].size());
+            std::memcpy(entry, &length, sizeof(length));
+            for (uint32_t k = 0; k < length; ++k) {
+                entry[sizeof(length) + k] = char(shapes[t][k]);
+            }
+        }
+        out.write(head.data(), head.size());
+        out.write(reinterpret_cast<const char*>(weights),
+                  weight_count * sizeof(float));
+        if (!out) {
+            throw std::runtime_error("cannot write " + path);
+        }
+    }
+
+    const std::vector<shape>& tuples() const { return shapes; }
+
+    // Value of an afterstate.
+    float value(bitboard::raw_t board) const {
+        float sum = 0;
+        for (const feature& f : features) {
+            sum += weights[f.offset + f.index(board)];
+        }
+        return sum;
+    }
+
+    // Moves the value of an afterstate by `delta`, spread evenly over its
+    // features. Only for networks held in memory.
+    void update(bitboard::raw_t board, float delta) {
+        const float step = delta / float(features.size());
+        for (const feature& f : features) {
+            owned[f.offset + f.index(board)] += step;
+        }
+    }
+
+    // Value of a position: the best move's score plus the value of the
+    // afterstate it leads to, 0 if no move is left.
+    double evaluate(const bitboard& board) const override {
+        double best = 0;
+        for (int dir = direction::left; dir < 4; ++dir) {
+            bitboard after = board;
+            after.move(dir);
+            if (after == board) {
+                continue;
+            }
+            const double gain = double(after.get_score() - board.get_score());
+            best = std::max(best, gain + value(after.raw()));
+        }
+        return best;
+    }
+
+   private:
+    static constexpr size_t HEADER_BYTES = sizeof(MAGIC) + 2 * 4;
+    static constexpr size_t TUPLE_BYTES = 16;
+
+    // one tuple on one image: where its cells' nibbles are in the board
+    struct feature {
+        uint32_t offset;  // of the tuple's weights
+        int length;
+        std::array<uint8_t, MAX_TUPLE> shift;
+
+        uint32_t index(bitboard::raw_t board) const {
+            uint32_t idx = 0;
+            for (int k = 0; k < length; ++k) {
+                idx |= uint32_t((board >> shift[k]) & 0xF) << (4 * k);
+            }
+            return idx;
+        }
+    };
+
+    std::vector<shape> shapes;
+    std::vector<feature> features;
+    size_t weight_count = 0;
+    const float* weights = nullptr;
+    std::unique_ptr<float[]> owned;  // weights held in memory
+    mapped_file file;                // or mapped from a file
+
+    ntuple_network() = default;
+
+    static size_t weights_offset(size_t tuple_count) {
+        return (HEADER_BYTES + tuple_count * TUPLE_BYTES + 63) / 64 * 64;
+    }
+
+    void layout() {
+        features.clear();
+        weight_count = 0;
+        for (const shape& cells : shapes) {
+            if (cells.empty() || cells.size() > MAX_TUPLE) {
+                throw std::invalid_argument("tuple length out of range");
+            }
+            for (size_t k = 0; k < cells.size(); ++k) {
+                if (cells[k] < 0 || cells[k] >= SIZE * SIZE ||
+                    std::count(cells.begin(), cells.end(), cells[k]) > 1) {
+                    throw std::invalid_argument("bad tuple cell");
+                }
+            }
+            // the tuple placed on image `sym` reads the original cells
+            // that land on its own cells
+            for (int sym = 0; sym < symmetry::COUNT; ++sym) {
+                feature f{uint32_t(weight_count), int(cells.size()), {}};
+                for (size_t k = 0; k < cells.size(); ++k) {
+                    const auto [x, y] = symmetry::source_cell(
+                        sym, SIZE, cells[k] / SIZE, cells[k] % SIZE);
+                    f.shift[k] = uint8_t(4 * (x * SIZE + y));
+                }
+                features.push_back(f);
+            }
+            weight_count += size_t(1) << (4 * cells.size());
+        }
+    }
+};
+}  // namespace core
@@ -0,0 +1,258 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mapped_file.hpp"
+
+#if CORE_HAS_MMAP
+#include <sys/file.h>
+#endif
+
+namespace core {
+// Search results kept on disk across runs: canonical position key -> packed
+// cache value, whose low 4 bits are the search depth as in
+// transposition_table. A store maps its file read-only when opened, so
+// pages load on first lookup and are shared by every process using the
+// file; results recorded meanwhile stay in memory until merge() adds them
+// to the file. Lookups see the file as it was when opened.
+//
+// File layout, native byte order: the 8-byte MAGIC and the uint64
+// fingerprint of the search settings the values come from, then runs, each
+// a uint64 record count, 8 bytes of padding and that many records of key
+// and value as uint64, sorted by key. merge() appends one run, or folds
+// everything into one run once there would be MAX_RUNS.
+class position_store {
+   public:
+    static constexpr char MAGIC[8] = {'2', '0', '4', '8', 'P', 'S', 'T', '1'};
+    static constexpr int MAX_RUNS = 8;
+    static constexpr size_t MAX_PENDING = size_t(1) << 22;  // ~100 MB
+
+    // Maps the store at `path` if the file exists, otherwise starts empty.
+    // Throws std::runtime_error if it can't be read, isn't a store or holds
+    // values of other search settings than `fingerprint`.
+    position_store(std::string path, uint64_t fingerprint,
+                   size_t max_pending = MAX_PENDING)
+        : path(std::move(path)),
+          settings(fingerprint),
+          max_pending(max_pending) {
+        if (std::filesystem::exists(this->path)) {
+            file = mapped_file(this->path);
+            runs = parse(file);
+        }
+    }
+
+    position_store(const position_store&) = delete;
+    position_store& operator=(const position_store&) = delete;
+
+    uint64_t fingerprint() const { return settings; }
+
+    // Deepest value of `key` in the file.
+    bool find(uint64_t key, uint64_t& value) const {
+        bool found = false;
+        for (const run& r : runs) {
+            const entry* it = std::lower_bound(
+                r.begin, r.end, key,
+                [](const entry& rec, uint64_t k) { return rec.key < k; });
+            if (it != r.end && it->key == key &&
+                (!found || depth_of(it->value) > depth_of(value))) {
+                value = it->value;
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    // Keeps a result for the next merge, the deepest per key. Thread-safe;
+    // results beyond max_pending new keys are dropped.
+    void record(uint64_t key, uint64_t value) {
+        std::lock_guard lock(pending_mtx);
+        auto it = pending.find(key);
+        if (it == pending.end()) {
+            if (pending.size() < max_pending) {
+                pending.emplace(key, value);
+            }
+        } else if (depth_of(value) >= depth_of(it->second)) {
+            it->second = value;
+        }
+    }
+
+    // Records in the file as opened, counting keys once per run.
+    size_t size() const {
+        size_t count = 0;
+        for (const run& r : runs) {
+            count += size_t(r.end - r.begin);
+        }
+        return count;
+    }
+
+    size_t pending_size() const {
+        std::lock_guard lock(pending_mtx);
+        return pending.size();
+    }
+
+    // Adds the recorded results to the file as it is now, which other
+    // processes may have merged into since it was opened; merges are
+    // serialized by a lock on `path`.lock. Throws std::runtime_error if the
+    // file can't be written or now holds values of other settings.
+    void merge() {
+        std::lock_guard lock(pending_mtx);
+        if (pending.empty()) {
+            return;
+        }
+        std::vector<entry> fresh;
+        fresh.reserve(pending.size());
+        for (auto& [key, value] : pending) {
+            fresh.push_back({key, value});
+        }
+        std::sort(fresh.begin(), fresh.end(),
+                  [](const entry& a, const entry& b) {
+                      return a.key < b.key;
+                  });
+
+        const file_lock guard(path + ".lock");
+        mapped_file current;
+        std::vector<run> current_runs;
+        if (std::filesystem::exists(path)) {
+            current = mapped_file(path);
+            current_runs = parse(current);
+        }
+        const size_t complete =
+            current_runs.empty() ? 0
+                                 : size_t(reinterpret_cast<const std::byte*>(
+                                              current_runs.back().end) -
+                                          current.data());
+        if (complete > 0 && complete == current.size() &&
+            current_runs.size() + 1 < MAX_RUNS) {
+            std::ofstream out(path, std::ios::binary | std::ios::app);
+            write_run(out, fresh);
+        } else {
+            // a torn append of a crashed merge is dropped here too
+            std::vector<entry> all = std::move(fresh);
+            for (const run& r : current_runs) {
+                all.insert(all.end(), r.begin, r.end);
+            }
+            std::sort(all.begin(), all.end(),
+                      [](const entry& a, const entry& b) {
+                          return a.key != b.key
+                                     ? a.key < b.key
+                                     : depth_of(a.value) > depth_of(b.value);
+                      });
+            all.erase(std::unique(all.begin(), all.end(),
+                                  [](const entry& a, const entry& b) {
+                                      return a.key == b.key;
+                                  }),
+                      all.end());
+            const std::string temp = path + ".tmp";
+            {
+                std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+                out.write(MAGIC, sizeof(MAGIC));
+                out.write(reinterpret_cast<const char*>(&settings),
+                          sizeof(settings));
+                write_run(out, all);
+            }
+            // readers keep the file they mapped
+            std::filesystem::rename(temp, path);
+        }
+        pending.clear();
+    }
+
+   private:
+    struct entry {
+        uint64_t key;
+        uint64_t value;
+    };
+    struct run {
+        const entry* begin;
+        const entry* end;
+    };
+    static_assert(sizeof(entry) == 16);
+    static constexpr size_t HEADER_BYTES = 16;
+    static constexpr size_t RUN_HEADER_BYTES = 16;
+
+    // Exclusive lock on a file next to the store, held while merging. Only
+    // where mmap is, i.e. POSIX; elsewhere merges must not overlap.
+    struct file_lock {
+#if CORE_HAS_MMAP
+        int fd;
+
+        explicit file_lock(const std::string& lock_path)
+            : fd(::open(lock_path.c_str(), O_RDWR | O_CREAT, 0644)) {
+            if (fd < 0 || ::flock(fd, LOCK_EX) != 0) {
+                if (fd >= 0) {
+                    ::close(fd);
+                }
+                throw std::runtime_error("cannot lock " + lock_path);
+            }
+        }
+
+        ~file_lock() {
+            ::flock(fd, LOCK_UN);
+            ::close(fd);
+        }
+#else
+        explicit file_lock(const std::string&) {}
+#endif
+        file_lock(const file_lock&) = delete;
+        file_lock& operator=(const file_lock&) = delete;
+    };
+
+    std::string path;
+    uint64_t settings;
+    size_t max_pending;
+    mapped_file file;
+    std::vector<run> runs;
+    mutable std::mutex pending_mtx;
+    std::unordered_map<uint64_t, uint64_t> pending;
+
+    static int depth_of(uint64_t value) { return int(value & 0xF); }
+
+    // The complete runs of a mapped store; a run cut short by a crash ends
+    // the list.
+    std::vector<run> parse(const mapped_file& mapped) const {
+        const std::byte* data = mapped.data();
+        const size_t size = mapped.size();
+        uint64_t fingerprint;
+        if (size < HEADER_BYTES || std::memcmp(data, MAGIC, sizeof(MAGIC))) {
+            throw std::runtime_error(path + " is not a position store");
+        }
+        std::memcpy(&fingerprint, data + sizeof(MAGIC), sizeof(fingerprint));
+        if (fingerprint != settings) {
+            throw std::runtime_error(path +
+                                     " was written with other search settings");
+        }
+        std::vector<run> result;
+        size_t offset = HEADER_BYTES;
+        while (offset + RUN_HEADER_BYTES <= size) {
+            uint64_t count;
+            std::memcpy(&count, data + offset, sizeof(count));
+            offset += RUN_HEADER_BYTES;
+            if (count > (size - offset) / sizeof(entry)) {
+                break;
+            }
+            const auto* begin = reinterpret_cast<const entry*>(data + offset);
+            result.push_back({begin, begin + count});
+            offset += count * sizeof(entry);
+        }
+        return result;
+    }
+
+    void write_run(std::ofstream& out, const std::vector<entry>& records) {
+        const uint64_t header[2] = {records.size(), 0};
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(records.data()),
+                  records.size() * sizeof(entry));
+        out.flush();
+        if (!out) {
+            throw std::runtime_error("cannot write " + path);
+        }
+    }
+};
+}  // namespace core
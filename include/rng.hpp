@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <random>
+
+namespace core {
+inline uint64_t splitmix64(uint64_t& state) {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Fresh seed for boards nobody seeded explicitly: one random_device draw per
+// process, then a splitmix64 sequence, so it is cheap and thread-safe.
+inline uint64_t random_seed() {
+    static std::atomic<uint64_t> state{(uint64_t(std::random_device{}()) << 32) ^
+                                       std::random_device{}()};
+    uint64_t s = state.fetch_add(0x9e3779b97f4a7c15ULL);
+    return splitmix64(s);
+}
+
+// xoshiro256**: small, fast, and reproducible across platforms, unlike the
+// standard distributions. Satisfies UniformRandomBitGenerator.
+class rng {
+   public:
+    using result_type = uint64_t;
+
+    explicit rng(uint64_t seed_value = 0) { seed(seed_value); }
+
+    void seed(uint64_t seed_value) {
+        uint64_t sm = seed_value;
+        for (auto& word : s) {
+            word = splitmix64(sm);
+        }
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() {
+        return std::numeric_limits<result_type>::max();
+    }
+
+    result_type operator()() {
+        const uint64_t result = std::rotl(s[1] * 5, 7) * 9;
+        const uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = std::rotl(s[3], 45);
+        return result;
+    }
+
+    // Uniform in [0, bound) from a single draw (Lemire's multiply-shift;
+    // the bias is below 2^-32 for the bounds used here).
+    uint32_t below(uint32_t bound) {
+        return uint32_t(((*this)() >> 32) * bound >> 32);
+    }
+
+   private:
+    uint64_t s[4];
+};
+}  // namespace core
@@ -0,0 +1,215 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define CORE_ROW_KERNEL_SIMD 1
+#else
+#define CORE_ROW_KERNEL_SIMD 0
+#endif
+
+namespace core {
+// Slide and merge of one row of up to 16 cells held as log2 exponents, one
+// byte per cell from the cell tiles move to, by the rule of
+// board_2048::move: a tile merges into the previous tile if that one is
+// equal and has not merged yet.
+//
+// With SSSE3 the row is moved in one register without branching per cell:
+// a shuffle compacts the tiles, one compare finds the equal neighbours, the
+// pairing within runs of equal tiles is resolved on that bit mask, and a
+// second shuffle closes the gaps the merges leave. Otherwise a scalar loop.
+struct row_kernel {
+    static constexpr int MAX_WIDTH = 16;
+    using row = std::array<uint8_t, MAX_WIDTH>;
+
+    // Moves a row of up to 8 cells packed into a word, cell j in byte j,
+    // towards cell 0 and returns the score gained.
+    static constexpr uint64_t slide_and_merge(uint64_t& cells) {
+#if CORE_ROW_KERNEL_SIMD
+        if (!std::is_constant_evaluated()) {
+            __m128i v = _mm_cvtsi64_si128(int64_t(cells));
+            const uint64_t gain = slide_and_merge_simd<8>(v, 8);
+            cells = uint64_t(_mm_cvtsi128_si64(v));
+            return gain;
+        }
+#endif
+        return slide_and_merge_scalar(cells);
+    }
+
+    // Moves the first `width` cells of `cells` towards cell 0 and returns
+    // the score gained. Cells from `width` on must be zero.
+    static uint64_t slide_and_merge(row& cells, int width) {
+#if CORE_ROW_KERNEL_SIMD
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&cells));
+        const uint64_t gain = slide_and_merge_simd<16>(v, width);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&cells), v);
+        return gain;
+#else
+        return slide_and_merge_scalar(cells, width);
+#endif
+    }
+
+    static constexpr uint64_t slide_and_merge_scalar(uint64_t& cells) {
+        uint64_t gain = 0, out = 0;
+        int shift = 0;
+        uint8_t mergeable = 0;
+        for (uint64_t rest = cells; rest != 0; rest >>= 8) {
+            const uint8_t e = uint8_t(rest);
+            if (e == 0) {
+                continue;
+            }
+            if (e == mergeable) {
+                out += 1ULL << (shift - 8);
+                gain += 1ULL << (e + 1);
+                mergeable = 0;
+            } else {
+                out |= uint64_t(e) << shift;
+                shift += 8;
+                mergeable = e;
+            }
+        }
+        cells = out;
+        return gain;
+    }
+
+    static constexpr uint64_t slide_and_merge_scalar(row& cells, int width) {
+        uint64_t gain = 0;
+        int out = 0;
+        uint8_t mergeable = 0;
+        for (int i = 0; i < width; ++i) {
+            const uint8_t e = cells[i];
+            if (e == 0) {
+                continue;
+            }
+            if (e == mergeable) {
+                cells[out - 1] = e + 1;
+                gain += 1ULL << (e + 1);
+                mergeable = 0;
+            } else {
+                cells[out++] = e;
+                mergeable = e;
+            }
+        }
+        for (int i = out; i < width; ++i) {
+            cells[i] = 0;
+        }
+        return gain;
+    }
+
+    // Bit i of `equal` says cells i and i + 1 hold equal tiles. Of each run
+    // of equal tiles the first merges with the second, the third with the
+    // fourth and so on: returns the bits at even offsets into each run of
+    // ones. Runs starting on an even bit are found by adding their first
+    // bit, which carries through the run.
+    static constexpr unsigned first_of_pairs(unsigned equal) {
+        constexpr unsigned even = 0x55555555;
+        const unsigned starts = equal & ~(equal << 1);
+        const unsigned even_runs = equal & ~(equal + (starts & even));
+        return (even_runs & even) | (equal & ~even_runs & ~even);
+    }
+
+#if CORE_ROW_KERNEL_SIMD
+   private:
+    struct shuffles {
+        // for a mask of up to 8 cells: their indices in order, then 0xFF,
+        // which a shuffle turns into a zero byte
+        uint64_t low[256];
+        uint64_t high[256];  // the same for cells 8 to 15
+        // closes the gap between `count` cells compacted in the low half
+        // and the high half's
+        alignas(16) uint8_t join[9][16];
+
+        shuffles() {
+            for (unsigned mask = 0; mask < 256; ++mask) {
+                uint64_t lo = ~0ULL, hi = ~0ULL;
+                int out = 0;
+                for (int i = 0; i < 8; ++i) {
+                    if ((mask >> i) & 1) {
+                        lo = (lo & ~(0xFFULL << (8 * out))) |
+                             (uint64_t(i) << (8 * out));
+                        hi = (hi & ~(0xFFULL << (8 * out))) |
+                             (uint64_t(i + 8) << (8 * out));
+                        ++out;
+                    }
+                }
+                low[mask] = lo;
+                high[mask] = hi;
+            }
+            for (int count = 0; count <= 8; ++count) {
+                for (int i = 0; i < 16; ++i) {
+                    const int from = i < count ? i : i - count + 8;
+                    join[count][i] = uint8_t(from < 16 ? from : 0x80);
+                }
+            }
+        }
+    };
+
+    static const shuffles& tables() {
+        static const std::unique_ptr<const shuffles> table =
+            std::make_unique<const shuffles>();
+        return *table;
+    }
+
+    // the cells of `keep` moved to the front in order, zeros behind
+    template <int Width>
+    static __m128i compact(__m128i v, unsigned keep) {
+        const shuffles& t = tables();
+        if constexpr (Width == 8) {
+            return _mm_shuffle_epi8(
+                v, _mm_set_epi64x(-1, int64_t(t.low[keep])));
+        } else {
+            v = _mm_shuffle_epi8(v,
+                                 _mm_set_epi64x(int64_t(t.high[keep >> 8]),
+                                                int64_t(t.low[keep & 0xFF])));
+            return _mm_shuffle_epi8(
+                v, _mm_load_si128(reinterpret_cast<const __m128i*>(
+                       t.join[std::popcount(keep & 0xFF)])));
+        }
+    }
+
+    // 0xFF in every byte whose bit is set in `bits`
+    static __m128i byte_mask(unsigned bits) {
+        const __m128i select = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1,
+                                             2, 4, 8, 16, 32, 64, -128);
+        const __m128i spread = _mm_shuffle_epi8(
+            _mm_cvtsi32_si128(int(bits)),
+            _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1));
+        return _mm_cmpeq_epi8(_mm_and_si128(spread, select), select);
+    }
+
+    // the row in the low `width` <= Width bytes of `v`, the rest zero
+    template <int Width>
+    static uint64_t slide_and_merge_simd(__m128i& v, int width) {
+        const unsigned cells = (1u << width) - 1;
+        const unsigned tiles =
+            ~unsigned(_mm_movemask_epi8(
+                _mm_cmpeq_epi8(v, _mm_setzero_si128()))) &
+            cells;
+        v = compact<Width>(v, tiles);
+        const int count = std::popcount(tiles);
+        const __m128i next = _mm_srli_si128(v, 1);
+        const unsigned equal =
+            unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(v, next))) &
+            ((1u << std::max(count - 1, 0)) - 1);  // both cells hold tiles
+        uint64_t gain = 0;
+        if (equal != 0) {
+            const unsigned merged = first_of_pairs(equal);
+            v = _mm_sub_epi8(v, byte_mask(merged));  // grows by one
+            alignas(16) uint8_t grown[16];
+            _mm_store_si128(reinterpret_cast<__m128i*>(grown), v);
+            for (unsigned m = merged; m != 0; m &= m - 1) {
+                gain += 1ULL << grown[std::countr_zero(m)];
+            }
+            v = compact<Width>(v, ((1u << count) - 1) & ~(merged << 1));
+        }
+        return gain;
+    }
+#endif
+};
+}  // namespace core
@@ -0,0 +1,168 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "board_2048.hpp"
+#include "evaluator.hpp"
+#include "game_record.hpp"
+#include "position_store.hpp"
+#include "rng.hpp"
+#include "solver.hpp"
+
+namespace sim {
+struct batch_option {
+    int games = 100;
+    int depth = -3;  // same meaning as core::solver: <= 0 picks automatically
+    std::chrono::milliseconds time_budget{0};  // per move; overrides depth
+    double min_probability = 0;  // chance-node pruning threshold, 0 = off
+    int max_spawn_cells = 0;     // spawn cells sampled per chance node, 0 = all
+    int board_size = 4;
+    uint64_t seed = 0;
+    int threads = 0;  // 0: one per hardware thread
+    // leaf evaluation in place of the heuristic, shared by all games
+    std::shared_ptr<const core::evaluator> evaluator;
+    // results of earlier batches, shared by all games; opened with the
+    // fingerprint of a solver configured by configure_solver
+    std::shared_ptr<core::position_store> store;
+    // where to record every game, if anywhere
+    std::shared_ptr<core::record_writer> recorder;
+};
+
+struct game_summary {
+    int game = 0;
+    uint64_t seed = 0;
+    uint64_t score = 0;
+    int max_tile = 0;
+    int moves = 0;
+    std::chrono::nanoseconds search_time{0};
+    std::chrono::nanoseconds max_move_time{0};
+    core::solver::stats search;  // counters summed over all moves
+    long long depth_total = 0;   // sum of the depth searched per move
+
+    double mean_depth() const {
+        return moves == 0 ? 0.0 : double(depth_total) / moves;
+    }
+
+    double ms_per_move() const {
+        return moves == 0 ? 0.0
+                          : std::chrono::duration<double, std::milli>(
+                                search_time)
+                                    .count() /
+                                moves;
+    }
+};
+
+// Seed of game `game` in a batch, independent of which worker plays it.
+inline uint64_t game_seed(uint64_t batch_seed, int game) {
+    uint64_t state = batch_seed + 0x9e3779b97f4a7c15ULL * uint64_t(game);
+    return core::splitmix64(state);
+}
+
+inline int max_tile_of(const core::board_2048& board) {
+    int max_tile = 0;
+    for (int x = 0; x < board.size(); ++x) {
+        for (int y = 0; y < board.size(); ++y) {
+            max_tile = std::max(max_tile, board.get_tile(x, y));
+        }
+    }
+    return max_tile;
+}
+
+// Applies the search settings of `option`, all but the position store.
+inline void configure_solver(core::solver& solver, const batch_option& option) {
+    solver.set_depth(option.depth);
+    solver.set_time_budget(option.time_budget);
+    solver.set_min_probability(option.min_probability);
+    solver.set_max_spawn_cells(option.max_spawn_cells);
+    solver.set_evaluator(option.evaluator);
+}
+
+// Plays one game to the end with a fresh solver, no rendering.
+inline game_summary play_game(const batch_option& option, int game) {
+    using clock = std::chrono::steady_clock;
+    game_summary summary;
+    summary.game = game;
+    summary.seed = game_seed(option.seed, game);
+
+    core::board_2048 board(option.board_size, summary.seed);
+    core::solver solver;
+    configure_solver(solver, option);
+    solver.set_position_store(option.store);
+    core::game_record record(board, summary.seed,
+                             solver.settings_fingerprint(), option.depth);
+    while (!board.is_over()) {
+        const auto start = clock::now();
+        int dir = solver.get_best_move(board);
+        const auto elapsed = clock::now() - start;
+        summary.search.merge(solver.get_stats());
+        summary.depth_total += solver.get_stats().depth;
+        summary.search_time += elapsed;
+        summary.max_move_time = std::max(
+            summary.max_move_time,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed));
+
+        // a move that changes nothing must not spawn a tile
+        const int legal_moves = board.legal_moves_mask();
+        if (!((legal_moves >> dir) & 1)) {
+            dir = std::countr_zero(unsigned(legal_moves));
+        }
+        board.move(dir);
+        const int cell = board.add_random_tile();
+        if (option.recorder && cell >= 0) {
+            const int size = board.size();
+            record.add(dir, cell, board.get_tile(cell / size, cell % size));
+        }
+        ++summary.moves;
+    }
+    summary.score = board.get_score();
+    if (option.recorder) {
+        record.finish(summary.score);
+        option.recorder->write(record);
+    }
+    summary.max_tile = max_tile_of(board);
+    return summary;
+}
+
+// Plays `option.games` games spread over worker threads. `on_game` is called
+// from the workers, serialized, as each game finishes. The returned
+// summaries are ordered by game index.
+inline std::vector<game_summary> run_batch(
+    const batch_option& option,
+    std::function<void(const game_summary&)> on_game = {}) {
+    std::vector<game_summary> summaries(std::max(0, option.games));
+    int threads = option.threads > 0
+                      ? option.threads
+                      : int(std::max(1u, std::thread::hardware_concurrency()));
+    threads = std::clamp(threads, 1, std::max(1, option.games));
+
+    std::atomic<int> next_game = 0;
+    std::mutex report_mtx;
+    auto worker = [&] {
+        for (int game = next_game++; game < option.games; game = next_game++) {
+            summaries[game] = play_game(option, game);
+            if (on_game) {
+                std::lock_guard lock(report_mtx);
+                on_game(summaries[game]);
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threads; ++i) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& w : workers) {
+        w.join();
+    }
+    return summaries;
+}
+}  // namespace sim
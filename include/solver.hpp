@@ -1,135 +1,468 @@
 ﻿#pragma once
 #include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
 #include <cmath>
+#include <functional>
+#include <future>
 #include <memory>
 #include <mutex>
-#include <unordered_map>
+#include <stdexcept>
+#include <type_traits>
 #include <vector>
 
+#include "bitboard.hpp"
 #include "board_2048.hpp"
+#include "board_t.hpp"
+#include "evaluator.hpp"
+#include "hash.hpp"
+#include "heuristic.hpp"
+#include "position_store.hpp"
+#include "symmetry.hpp"
+#include "thread_pool.hpp"
+#include "transposition_table.hpp"
 namespace core {
 struct solver {
     using eval_t = uint64_t;
+    using clock = std::chrono::steady_clock;
     static constexpr int CACHE_DEPTH = 2;
     static constexpr int MAX_DEPTH = 10;
-    static constexpr int USUAL_CACHE = 1 << 16;
+    // depth setting searching 3 deeper than pick_depth, at most 11: cache
+    // entries hold the depth in 4 bits
+    static constexpr int MIN_DEPTH = -3;
     static constexpr eval_t MIN_EVAL = 0;
     static constexpr eval_t MAX_EVAL = 16ULL << 41;
     static constexpr eval_t MULT = 9e18 / (MAX_EVAL * 10 * 4 * 30 * 4 * 16);
-    static constexpr int MAX_CACHE = 1 << 20;
+    static constexpr int MAX_CACHE = 1 << 20;  // default cache entries
+    static constexpr int STORE_DEPTH = 3;  // least depth kept in a store
+    static constexpr uint64_t DEADLINE_CHECK_NODES = 256;  // power of two
+    static_assert(MULT * MAX_EVAL << 6 <=
+                  transposition_table::VALUE_MASK);  // packed entry fits
 
-    explicit solver(int depth = 2) : depth(depth) { init_cache(); }
+    // Instrumentation of one get_best_move. Pool tasks count into their own
+    // copy, merged when the task's result is collected, so counting needs
+    // no shared atomics.
+    struct stats {
+        uint64_t nodes = 0;
+        uint64_t cache_hits = 0;    // probes answered by a usable entry
+        uint64_t cache_misses = 0;  // probes that had to search the node
+        uint64_t cache_stores = 0;
+        uint64_t cache_evictions = 0;  // stores that dropped another position
+        uint64_t store_hits = 0;  // cache hits answered by the position store
+        int depth = 0;  // searched depth; for a time budget, the deepest
+                        // iteration the move came from
+        std::chrono::nanoseconds time{0};
 
-    int get_best_move(const board_2048& board_) { return pick_move(board_); }
+        // adds the counters; depth and time belong to the whole search
+        void merge(const stats& other) {
+            nodes += other.nodes;
+            cache_hits += other.cache_hits;
+            cache_misses += other.cache_misses;
+            cache_stores += other.cache_stores;
+            cache_evictions += other.cache_evictions;
+            store_hits += other.store_hits;
+        }
+
+        double cache_hit_rate() const {
+            const uint64_t probes = cache_hits + cache_misses;
+            return probes == 0 ? 0.0 : double(cache_hits) / probes;
+        }
+    };
+
+    // Values of the moves from one position, as get_best_move weighs them.
+    struct analysis {
+        int legal_moves = 0;  // mask of the directions that move
+        int best_move = -1;   // the best of `value`; -1 before any depth
+        // expected evaluation (see evaluate_board) after each legal move
+        double value[4] = {0, 0, 0, 0};
+        stats counters;  // depth of `value` and the work done up to it
+    };
+
+    explicit solver(int depth = 2) { set_depth(depth); }
+
+    // Searches on the fastest representation for the board's size, see
+    // dispatch_board. Once `*stop` becomes true the search unwinds quickly
+    // and the returned move is meaningless; the cache stays consistent.
+    int get_best_move(const board_2048& board_,
+                      const std::atomic<bool>* stop = nullptr) {
+        return dispatch_board(board_, [this, stop](const auto& board) {
+            return pick_move(board, stop);
+        });
+    }
+
+    int get_best_move(const bitboard& board_,
+                      const std::atomic<bool>* stop = nullptr) {
+        return pick_move(board_, stop);
+    }
+
+    template <int N>
+    int get_best_move(const board_t<N>& board_,
+                      const std::atomic<bool>* stop = nullptr) {
+        return pick_move(board_, stop);
+    }
+
+    // Searches every legal move of `board` to depth 1, 2, ... up to the
+    // depth get_best_move would use, or for a time budget as deep as it
+    // allows, and passes each depth's analysis to `report` once complete.
+    // The positions after each move and spawn are probed in the cache, so
+    // repeating a search, by get_best_move or analyze, answers from it. On
+    // a stop the deepest complete analysis is returned.
+    analysis analyze(const board_2048& board_,
+                     const std::atomic<bool>* stop = nullptr,
+                     const std::function<void(const analysis&)>& report = {}) {
+        return dispatch_board(board_, [&](const auto& board) {
+            return analyze_moves(board, stop, report);
+        });
+    }
+
+    // Depth of the search; 0 or less picks one by the board (pick_depth)
+    // and adds -depth. Clamped to [MIN_DEPTH, MAX_DEPTH].
+    void set_depth(int depth) {
+        this->depth = std::clamp(depth, MIN_DEPTH, MAX_DEPTH);
+    }
+
+    int get_depth() const { return depth; }
+
+    // Wall-clock time per move. While non-zero the depth setting is ignored
+    // and each move deepens iteratively until the budget runs out.
+    void set_time_budget(std::chrono::milliseconds budget) {
+        time_budget = budget;
+    }
+
+    std::chrono::milliseconds get_time_budget() const { return time_budget; }
+
+    // Chance-node pruning: a spawn reached with a path probability below
+    // `probability` is evaluated as a leaf. 0 (the default) disables it.
+    void set_min_probability(double probability) {
+        min_probability = probability;
+    }
+
+    double get_min_probability() const { return min_probability; }
+
+    // Expands at most `cells` spawn cells per chance node, spread evenly
+    // over the empty cells; 0 (the default) expands all of them.
+    void set_max_spawn_cells(int cells) {
+        max_spawn_cells = std::max(0, cells);
+    }
+
+    int get_max_spawn_cells() const { return max_spawn_cells; }
+
+    // Leaf evaluation for boards searched as bitboards (4x4 with tiles up
+    // to 16384); nullptr restores the built-in heuristic. Clears the cache,
+    // whose values were made by the previous evaluator.
+    void set_evaluator(std::shared_ptr<const evaluator> eval) {
+        leaf_evaluator = std::move(eval);
+        cache.clear();
+    }
+
+    const std::shared_ptr<const evaluator>& get_evaluator() const {
+        return leaf_evaluator;
+    }
+
+    // Number of threads searching the root moves and their chance nodes;
+    // 1 (the default) searches on the calling thread.
+    void set_threads(int threads) {
+        if (threads <= 1) {
+            pool.reset();
+        } else if (!pool || pool->size() != threads) {
+            pool = std::make_unique<thread_pool>(threads);
+        }
+    }
+
+    int get_threads() const { return pool ? pool->size() : 1; }
+
+    // Memory budget of the cache, rounded down to a power of two; clears it.
+    void set_cache_size(size_t bytes) { cache.resize(bytes); }
+
+    size_t get_cache_size() const { return cache.memory(); }
+
+    void clear_cache() { cache.clear(); }
+
+    // Every search ages the cache by one generation, and results more than
+    // transposition_table::MAX_AGE generations old are ignored. Setting the
+    // generation a position was searched in, e.g. when undoing back to it,
+    // makes its results fresh again.
+    int get_cache_generation() const { return cache.get_generation(); }
+
+    void set_cache_generation(int generation) {
+        cache.set_generation(generation);
+    }
+
+    // Results of earlier runs, probed when the cache misses at depth
+    // STORE_DEPTH or more; the results searched at that depth are recorded
+    // into it. Throws std::invalid_argument unless the store was opened with
+    // settings_fingerprint(). nullptr detaches it.
+    void set_position_store(std::shared_ptr<position_store> positions) {
+        if (positions && positions->fingerprint() != settings_fingerprint()) {
+            throw std::invalid_argument(
+                "position store of other search settings");
+        }
+        store = std::move(positions);
+    }
+
+    // Identifies the settings cached values depend on. Values of different
+    // evaluators of the same kind can't be told apart: keep one store per
+    // weights file.
+    uint64_t settings_fingerprint() const {
+        uint64_t h = fmix64(std::bit_cast<uint64_t>(min_probability));
+        h = fmix64(h ^ uint64_t(max_spawn_cells));
+        h = fmix64(h ^ (leaf_evaluator ? 1 : 0));
+        h = fmix64(h ^ MULT);
+#ifdef REQUIRE_DETERMINISTIC
+        h = fmix64(h ^ 1);  // exact depth entries only
+#endif
+        return h;
+    }
+
+    // Nodes expanded by the last get_best_move.
+    uint64_t get_node_count() const { return last_stats.nodes; }
 
-    void set_depth(int depth) { this->depth = depth; }
+    // Statistics of the last get_best_move.
+    const stats& get_stats() const { return last_stats; }
 
    private:
     int depth;
-    using cache_t = std::unordered_map<board_2048, eval_t>;
-    cache_t cache;
-    board_2048 deletion_queue[MAX_CACHE];
-    int q[4] = {0, 0, 0, 0};
-    int q_end = 0;
+    std::unique_ptr<thread_pool> pool;
+    stats last_stats;
+    const std::atomic<bool>* search_stop = nullptr;  // during get_best_move
+    std::chrono::milliseconds time_budget{0};
+    double min_probability = 0;
+    int max_spawn_cells = 0;
+    std::shared_ptr<const evaluator> leaf_evaluator;
+    std::shared_ptr<position_store> store;
+    clock::time_point deadline;
+    std::atomic<bool> timed_out = false;
 
-    void init_cache() { cache.reserve(USUAL_CACHE); }
+    transposition_table cache{MAX_CACHE * transposition_table::ENTRY_BYTES};
 
-    void add_to_cache(const board_2048& board, const eval_t score,
-                      const int move, const int depth) {
-        cache[board] = (((score << 2) | move) << 4) | depth;
+    // Positions are cached under the least of their images (see symmetry),
+    // so mirrored and rotated positions share an entry. `sym` maps the
+    // position onto that image; cached moves are stored for the image.
+    struct position_key {
+        uint64_t key = 0;
+        int sym = 0;
+    };
 
-        // relies on MAX_CACHE being a power of 2
-        deletion_queue[q_end & (MAX_CACHE - 1)] = board;
-        ++q_end;
-        if (q[0] + MAX_CACHE == q_end) {
-            cache.erase(deletion_queue[q[0]++]);
-            if (q[0] >= MAX_CACHE) {
-                q[0] -= MAX_CACHE;
-                q[1] -= MAX_CACHE;
-                q[2] -= MAX_CACHE;
-                q[3] -= MAX_CACHE;
-                q_end -= MAX_CACHE;
-            }
-        }
+    // Symmetries evaluate_board is invariant under on a `size` board
+    static constexpr int symmetries(int size) {
+        return corner_weights_symmetric(size) ? symmetry::COUNT
+                                              : symmetry::MIRRORS;
     }
 
-    void update_cache_pointers() {
-        while (q[0] < q[1]) {  // delete everything in range q_0 ... q_1
-            cache.erase(deletion_queue[q[0]++]);
-            if (q[0] >= MAX_CACHE) {
-                q[0] -= MAX_CACHE;
-                q[1] -= MAX_CACHE;
-                q[2] -= MAX_CACHE;
-                q[3] -= MAX_CACHE;
-                q_end -= MAX_CACHE;
-            }
+    static position_key cache_key(const bitboard& board) {
+        static_assert(symmetries(bitboard::brd_size) == symmetry::COUNT);
+        const auto [bits, sym] = bitboard::canonical(board.raw());
+        return {bits, sym};
+    }
+
+    // Not O(1): picking the least image compares tiles up to the first
+    // difference per symmetry, and hashing an image other than the board
+    // itself is a pass over the tiles. Keeping all eight image hashes up
+    // to date instead made every move pay for them, and searched no faster.
+    static position_key cache_key(const board_2048& board) {
+        // the keys are already seeded with the size
+        const int sym = symmetry::canonical(board, symmetries(board.size()));
+        return {board.hash(sym), sym};
+    }
+
+    template <int N>
+    static position_key cache_key(const board_t<N>& board) {
+        const int sym = symmetry::canonical(board, symmetries(N));
+        return {symmetry::apply(board, sym).hash(),  // already seeded with N
+                sym};
+    }
+
+    // Probes for an entry usable at `cur_depth`, then the position store,
+    // counting the outcome. The move in a hit is mapped back onto the
+    // position.
+    bool find_in_cache(const position_key& key, const int cur_depth,
+                       eval_t& entry, stats& counters) {
+        bool found = cache.probe(key.key, entry) && usable(entry, cur_depth);
+        if (!found && store && cur_depth >= STORE_DEPTH &&
+            store->find(key.key, entry) && usable(entry, cur_depth)) {
+            cache.store(key.key, entry);
+            ++counters.store_hits;
+            found = true;
+        }
+        if (found) {
+            ++counters.cache_hits;
+            const int move = symmetry::unmap_move(key.sym, int(entry >> 4) & 3);
+            entry = (entry & ~eval_t(3 << 4)) | (eval_t(move) << 4);
+            return true;
         }
-        q[1] = std::max(q[0], q[2]);
-        q[2] = std::max(q[0], q[3]);  // possible that stuff was deleted while
-                                      // searching because cache got too big
-        q[3] = q_end;
+        ++counters.cache_misses;
+        return false;
     }
 
-    int pick_move(const board_2048& board) {
-        const int depth_to_use = depth <= 0 ? pick_depth(board) - depth : depth;
+    void add_to_cache(const position_key& key, const eval_t score,
+                      const int move, const int depth, stats& counters) {
+        ++counters.cache_stores;
+        const int image_move = symmetry::map_move(key.sym, move);
+        const eval_t entry = (((score << 2) | image_move) << 4) | depth;
+        if (cache.store(key.key, entry)) {
+            ++counters.cache_evictions;
+        }
+        if (store && depth >= STORE_DEPTH) {
+            store->record(key.key, entry);
+        }
+    }
 
-        const int move = expectimax(board, depth_to_use, 0) & 3;
-        update_cache_pointers();
+    template <typename Board>
+    int pick_move(const Board& board, const std::atomic<bool>* stop) {
+        const auto start = clock::now();
+        search_stop = stop;
+        timed_out = false;
+        stats counters;
+        int move;
+        if (time_budget.count() > 0) {
+            move = deepen(board, counters);
+        } else {
+            counters.depth = depth <= 0 ? pick_depth(board) - depth : depth;
+            move = (pool && counters.depth >= 2
+                        ? expectimax_parallel(board, counters.depth, counters)
+                        : expectimax(board, counters.depth, 0, 1.0, counters)) &
+                   3;
+        }
+        cache.new_generation();
+        search_stop = nullptr;
+        counters.time = clock::now() - start;
+        last_stats = counters;
         return move;
     }
 
-   private:
-    eval_t expectimax(const board_2048& board, const int cur_depth,
-                      const int fours) {
-        if (board.is_over()) {
+    template <typename Board>
+    analysis analyze_moves(
+        const Board& board, const std::atomic<bool>* stop,
+        const std::function<void(const analysis&)>& report) {
+        const auto start = clock::now();
+        search_stop = stop;
+        timed_out = false;
+        deadline = start + time_budget;
+        analysis result;
+        result.legal_moves = board.legal_moves_mask();
+        stats counters;
+        const int last = time_budget.count() > 0 ? MAX_DEPTH
+                         : depth <= 0           ? pick_depth(board) - depth
+                                                : depth;
+        int first = std::countr_zero(unsigned(result.legal_moves)) & 3;
+        for (int d = 1; d <= last && result.legal_moves != 0; ++d) {
+            check_deadline();
+            eval_t value[4];
+            if (stopped() || root_values(board, result.legal_moves, d, first,
+                                         value, counters) !=
+                                 result.legal_moves) {
+                break;
+            }
+            const eval_t best = pick_best(result.legal_moves, value);
+            first = int(best & 3);  // searched first at the next depth
+            if (cacheable(d, 0)) {
+                add_to_cache(cache_key(board), best >> 2, first, d, counters);
+            }
+            result.best_move = first;
+            for (int i = direction::left; i < 4; ++i) {
+                result.value[i] = ((result.legal_moves >> i) & 1)
+                                      ? double(value[i]) / MULT
+                                      : 0.0;
+            }
+            counters.depth = d;
+            counters.time = clock::now() - start;
+            result.counters = counters;
+            if (report) {
+                report(result);
+            }
+        }
+        cache.new_generation();
+        search_stop = nullptr;
+        counters.time = clock::now() - start;
+        last_stats = counters;
+        return result;
+    }
+
+    // Iterative deepening within time_budget. Each iteration reuses what
+    // the previous ones left in the cache and searches their best move
+    // first. An iteration cut short by the deadline still counts if that
+    // move finished: the best of the moves finished with it is returned.
+    template <typename Board>
+    int deepen(const Board& board, stats& counters) {
+        deadline = clock::now() + time_budget;
+        const int legal_moves = board.legal_moves_mask();
+        if (legal_moves == 0) {
+            return direction::left;
+        }
+        int best_move = std::countr_zero(unsigned(legal_moves));
+        if (std::has_single_bit(unsigned(legal_moves))) {
+            return best_move;  // nothing to choose from
+        }
+        const position_key key = cache_key(board);
+        for (int d = 1; d <= MAX_DEPTH && clock::now() < deadline; ++d) {
+            eval_t entry;
+            if (cacheable(d, 0) && find_in_cache(key, d, entry, counters)) {
+                best_move = int(entry >> 4) & 3;
+                counters.depth = d;
+                continue;
+            }
+            eval_t value[4];
+            const int done =
+                root_values(board, legal_moves, d, best_move, value, counters);
+            if (!((done >> best_move) & 1)) {
+                break;
+            }
+            const eval_t best = pick_best(done, value);
+            best_move = int(best & 3);
+            counters.depth = d;
+            if (done != legal_moves) {
+                break;
+            }
+            if (cacheable(d, 0)) {
+                add_to_cache(key, best >> 2, best_move, d, counters);
+            }
+        }
+        return best_move;
+    }
+
+    template <typename Board>
+    eval_t expectimax(const Board& board, const int cur_depth,
+                      const int fours, const double prob, stats& counters) {
+        ++counters.nodes;
+        if ((counters.nodes & (DEADLINE_CHECK_NODES - 1)) == 0) {
+            check_deadline();
+        }
+        if (stopped()) {
+            // abandoned: every node above sees the request too and skips
+            // the cache, so the bogus value is never stored
+            return 0;
+        }
+        const int legal_moves = board.legal_moves_mask();
+        if (legal_moves == 0) {
             const eval_t score = MULT * evaluate_board(board);
             return (score - (score >> 2))
                    << 2;  // subtract score / 4 as penalty for dying, then pack
         }
-        if (cur_depth == 0 || fours >= 4) {  // selecting 4 fours has a 0.01%
-                                             // chance, which is negligible
+        // selecting 4 fours has a 0.01% chance, which is negligible; so is
+        // any path less likely than min_probability
+        if (cur_depth == 0 || fours >= 4 || prob < min_probability) {
             return (MULT * evaluate_board(board)) << 2;
         }
 
-        if (cur_depth >= CACHE_DEPTH) {
-            const auto it = cache.find(board);
-#ifdef REQUIRE_DETERMINISTIC
-            if (it != cache.end() && (it->second & 0xF) == cur_depth)
-                return it->second >> 4;
-#else
-            if (it != cache.end() && (it->second & 0xF) >= cur_depth)
-                return it->second >> 4;
-#endif
+        const bool cached = cacheable(cur_depth, fours);
+        const position_key key = cached ? cache_key(board) : position_key{};
+        eval_t entry;
+        if (cached && find_in_cache(key, cur_depth, entry, counters)) {
+            return entry >> 4;
         }
 
         eval_t best_score = MIN_EVAL;
         int best_move = -1;
         for (int i = direction::left; i < 4; ++i) {
-            eval_t expected_score = 0;
-            board_2048 new_board = board;
-            new_board.move(i);
-            if (board == new_board) {
+            if (!((legal_moves >> i) & 1)) {
                 continue;
-            } else {
-                int cnt_empty = 0;
-                for (auto& tile : new_board.brd) {
-                    if (!tile) {
-                        tile = 2;
-                        expected_score +=
-                            9 *
-                            (expectimax(new_board, cur_depth - 1, fours) >> 2);
-                        tile = 4;
-                        expected_score +=
-                            1 *
-                            (expectimax(new_board, cur_depth - 1, fours + 1) >>
-                             2);
-                        tile = 0;
-                        ++cnt_empty;
-                    }
-                }
-                expected_score /=
-                    cnt_empty * 10;  // convert to actual expected score * MULT
             }
+            Board new_board = board;
+            new_board.move(i);
+            const eval_t expected_score =
+                chance_value(new_board, cur_depth, fours, prob, counters) +
+                move_reward(board, new_board);
 
             if (best_score <= expected_score) {
                 best_score = expected_score;
@@ -137,14 +470,259 @@ struct solver {
             }
         }
 
-        if (cur_depth >= CACHE_DEPTH) {
-            add_to_cache(board, best_score, best_move, cur_depth);
+        if (cached && !stopped()) {
+            add_to_cache(key, best_score, best_move, cur_depth, counters);
         }
 
         return (best_score << 2) | best_move;  // pack both score and move
     }
 
-    int pick_depth(const board_2048& board) {
+    // Expected value of the position after a move, reached with path
+    // probability `prob`: the spawn cells (see for_each_spawn_cell) with a 2
+    // (weight 9) or a 4 (weight 1), searched to cur_depth - 1. `board` is
+    // restored before returning.
+    template <typename Board>
+    eval_t chance_value(Board& board, const int cur_depth, const int fours,
+                        const double prob, stats& counters) {
+        eval_t expected_score = 0;
+        const int cnt_empty = for_each_spawn_cell(
+            board, prob, [&](const int x, const int y, const double p) {
+                board.set_tile(x, y, 2);
+                expected_score +=
+                    9 * (expectimax(board, cur_depth - 1, fours, p * 0.9,
+                                    counters) >>
+                         2);
+                board.set_tile(x, y, 4);
+                expected_score +=
+                    1 * (expectimax(board, cur_depth - 1, fours + 1, p * 0.1,
+                                    counters) >>
+                         2);
+                board.set_tile(x, y, 0);
+            });
+        return expected_score /
+               (cnt_empty * 10);  // convert to actual expected score * MULT
+    }
+
+    // Calls f(x, y, p) for each empty cell a chance node expands, p being
+    // the path probability `prob` times the chance of that cell. When there
+    // are more empty cells than max_spawn_cells, that many are picked,
+    // spread evenly over them. Returns the number of cells expanded.
+    template <typename Board, typename F>
+    int for_each_spawn_cell(const Board& board, const double prob,
+                            F&& f) const {
+        const int empty = min_probability > 0 || max_spawn_cells > 0
+                              ? board.count_empty_tiles()
+                              : 0;
+        const int picks =
+            max_spawn_cells > 0 ? std::min(empty, max_spawn_cells) : empty;
+        const double cell_prob = empty > 0 ? prob / empty : prob;
+        int expanded = 0, index = 0;
+        const int size = board.size();
+        for (int x = 0; x < size; ++x) {
+            for (int y = 0; y < size; ++y) {
+                if (board.get_tile(x, y)) {
+                    continue;
+                }
+                const int j = index++;
+                if (picks < empty &&
+                    (j + 1) * picks / empty == j * picks / empty) {
+                    continue;
+                }
+                f(x, y, cell_prob);
+                ++expanded;
+            }
+        }
+        return expanded;
+    }
+
+    // Best of the moves in `mask`, packed like expectimax's result; ties go
+    // to the later direction, as in expectimax.
+    static eval_t pick_best(const int mask, const eval_t (&value)[4]) {
+        eval_t best_score = MIN_EVAL;
+        int best_move = -1;
+        for (int i = direction::left; i < 4; ++i) {
+            if (((mask >> i) & 1) && best_score <= value[i]) {
+                best_score = value[i];
+                best_move = i;
+            }
+        }
+        return (best_score << 2) | best_move;
+    }
+
+    bool stopped() const {
+        return timed_out.load(std::memory_order_relaxed) ||
+               (search_stop && search_stop->load(std::memory_order_relaxed));
+    }
+
+    void check_deadline() {
+        if (time_budget.count() > 0 && clock::now() >= deadline) {
+            timed_out.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    static bool usable(const eval_t entry, const int cur_depth) {
+#ifdef REQUIRE_DETERMINISTIC
+        return int(entry & 0xF) == cur_depth;
+#else
+        return int(entry & 0xF) >= cur_depth;
+#endif
+    }
+
+    bool cacheable(const int cur_depth, const int fours) const {
+#ifdef REQUIRE_DETERMINISTIC
+        constexpr bool deterministic = true;
+#else
+        constexpr bool deterministic = false;
+#endif
+        // the `fours` and probability cutoffs make a node's value depend on
+        // its path; only caching four-free paths, without pruning, keeps
+        // results independent of search order, so the parallel search
+        // returns exactly what the serial one does
+        return cur_depth >= CACHE_DEPTH &&
+               (!deterministic || (fours == 0 && min_probability == 0));
+    }
+
+    // Same search as expectimax(board, cur_depth, 0, 1.0), with every chance
+    // node under the root moves evaluated as a separate task on the pool.
+    template <typename Board>
+    eval_t expectimax_parallel(const Board& board, const int cur_depth,
+                               stats& counters) {
+        const int legal_moves = board.legal_moves_mask();
+        if (legal_moves == 0) {
+            return expectimax(board, cur_depth, 0, 1.0, counters);
+        }
+        const bool cached = cacheable(cur_depth, 0);
+        const position_key key = cached ? cache_key(board) : position_key{};
+        eval_t entry;
+        if (cached && find_in_cache(key, cur_depth, entry, counters)) {
+            ++counters.nodes;
+            return entry >> 4;
+        }
+
+        eval_t value[4];
+        root_values(board, legal_moves, cur_depth, direction::left, value,
+                    counters);
+        const eval_t best = pick_best(legal_moves, value);
+
+        if (cached && !stopped()) {
+            add_to_cache(key, best >> 2, int(best & 3), cur_depth, counters);
+        }
+
+        return best;
+    }
+
+    // Expected value of every legal root move, searched starting from move
+    // `first`, on the pool when there is one. Returns the mask of the moves
+    // whose value completed before the search was stopped.
+    template <typename Board>
+    int root_values(const Board& board, const int legal_moves,
+                    const int cur_depth, const int first, eval_t (&value)[4],
+                    stats& counters) {
+        ++counters.nodes;
+        if (pool && cur_depth >= 2) {
+            return root_values_parallel(board, legal_moves, cur_depth, first,
+                                        value, counters);
+        }
+        int done = 0;
+        for (int k = 0; k < 4; ++k) {
+            const int i = (first + k) & 3;
+            if (!((legal_moves >> i) & 1)) {
+                continue;
+            }
+            Board new_board = board;
+            new_board.move(i);
+            value[i] = chance_value(new_board, cur_depth, 0, 1.0, counters) +
+                       move_reward(board, new_board);
+            if (stopped()) {
+                break;
+            }
+            done |= 1 << i;
+        }
+        return done;
+    }
+
+    template <typename Board>
+    int root_values_parallel(const Board& board, const int legal_moves,
+                             const int cur_depth, const int first,
+                             eval_t (&value)[4], stats& counters) {
+        struct chance_result {
+            eval_t value;  // already weighted by 9 or 1
+            stats counters;
+            bool complete;  // not cut short by a stop
+        };
+        struct chance_node {
+            int move;
+            std::future<chance_result> result;
+        };
+        std::vector<chance_node> chance_nodes;
+        auto spawn = [&](const int move, const Board& child,
+                         const eval_t weight, const int fours,
+                         const double prob) {
+            chance_nodes.push_back(
+                {move,
+                 pool->submit([this, child, weight, cur_depth, fours, prob] {
+                     stats task_counters;
+                     const eval_t value = expectimax(
+                         child, cur_depth - 1, fours, prob, task_counters);
+                     return chance_result{weight * (value >> 2), task_counters,
+                                          !stopped()};
+                 })});
+        };
+
+        int cnt_empty[4] = {0, 0, 0, 0};
+        eval_t reward[4] = {0, 0, 0, 0};
+        for (int k = 0; k < 4; ++k) {
+            const int i = (first + k) & 3;
+            if (!((legal_moves >> i) & 1)) {
+                continue;
+            }
+            Board new_board = board;
+            new_board.move(i);
+            reward[i] = move_reward(board, new_board);
+            cnt_empty[i] = for_each_spawn_cell(
+                new_board, 1.0, [&](const int x, const int y, const double p) {
+                    new_board.set_tile(x, y, 2);
+                    spawn(i, new_board, 9, 0, p * 0.9);
+                    new_board.set_tile(x, y, 4);
+                    spawn(i, new_board, 1, 1, p * 0.1);
+                    new_board.set_tile(x, y, 0);
+                });
+        }
+
+        int done = legal_moves;
+        for (int i = direction::left; i < 4; ++i) {
+            value[i] = 0;
+        }
+        for (auto& node : chance_nodes) {
+            const chance_result result = node.result.get();
+            value[node.move] += result.value;
+            counters.merge(result.counters);
+            if (!result.complete) {
+                done &= ~(1 << node.move);
+            }
+        }
+        for (int i = direction::left; i < 4; ++i) {
+            if ((legal_moves >> i) & 1) {
+                value[i] = value[i] / (cnt_empty[i] * 10) + reward[i];
+            }
+        }
+        return done;
+    }
+
+    // An evaluator values what is still to come, so with one every move
+    // also counts the score it made.
+    template <typename Board>
+    eval_t move_reward(const Board& before, const Board& after) const {
+        if constexpr (std::is_same_v<Board, bitboard>) {
+            if (leaf_evaluator) {
+                return MULT * (after.get_score() - before.get_score());
+            }
+        }
+        return 0;
+    }
+
+    template <typename Board>
+    int pick_depth(const Board& board) {
         const int tile_ct = board.count_tiles();
         const int score = board.count_distinct_tiles() +
                           (tile_ct <= 6 ? 0 : (tile_ct - 6) >> 1);
@@ -152,30 +730,65 @@ struct solver {
                (score >= 15) + (score >= 17) + (score >= 19);
     }
 
-    eval_t evaluate_board(const board_2048& board) {
-        int size = board.size();
-        auto calculate_corner_value = [&](int start_x, int start_y, int dx,
-                                          int dy) {
-            eval_t value = 0;
-            int init_weight = 20, weight = 20;
+   public:
+    // Heuristic value of a position, the leaf evaluation of the search: the
+    // best of the four corners' weighted tile sums (see corner_weight). The
+    // corners' weights mirror one table, so a single pass over its triangle
+    // accumulates all four; the bitboard reads them per packed row. Bitboards
+    // go to the evaluator instead when one is set.
+    template <typename Board>
+    eval_t evaluate_board(const Board& board) const {
+        if constexpr (std::is_same_v<Board, bitboard>) {
+            if (leaf_evaluator) {
+                return eval_t(std::clamp(leaf_evaluator->evaluate(board), 0.0,
+                                         double(MAX_EVAL)));
+            }
+            return evaluate_rows(board.raw());
+        } else {
+            const int size = board.size();
+            eval_t lower_left = 0, upper_left = 0, lower_right = 0,
+                   upper_right = 0;
             for (int i = 0; i < size; ++i) {
-                weight = init_weight;
+                const int ri = size - 1 - i;
                 for (int j = 0; j < size - i; ++j) {
-                    value += weight *
-                             board.get_tile(start_x + i * dx, start_y + j * dy);
-                    weight = std::max(1, weight / 2);
+                    const int rj = size - 1 - j;
+                    const eval_t weight = weight_of<Board>(size, i, j);
+                    lower_right += weight * board.get_tile(i, j);
+                    lower_left += weight * board.get_tile(i, rj);
+                    upper_right += weight * board.get_tile(ri, j);
+                    upper_left += weight * board.get_tile(ri, rj);
                 }
-                init_weight /= 2;
             }
-            return value;
-        };
+            return std::max({lower_left, upper_left, lower_right, upper_right});
+        }
+    }
 
-        const eval_t lower_left = calculate_corner_value(0, size - 1, 1, -1);
-        const eval_t upper_left =
-            calculate_corner_value(size - 1, size - 1, -1, -1);
-        const eval_t lower_right = calculate_corner_value(0, 0, 1, 1);
-        const eval_t upper_right = calculate_corner_value(size - 1, 0, -1, 1);
+   private:
+    // constexpr table for compile-time sizes, the closed form otherwise
+    template <typename Board>
+    static eval_t weight_of(int size, int i, int j) {
+        if constexpr (requires { Board::CELLS; }) {
+            return corner_weights<Board::size()>[i][j];
+        } else {
+            return corner_weight(size, i, j);
+        }
+    }
 
+    // Row x of a corner's sum is sum[x] for the corner in row 0 and
+    // sum[3 - x] for the corner in row 3; reversing the row mirrors columns.
+    static eval_t evaluate_rows(bitboard::raw_t bits) {
+        const auto& table = eval_row_tables();
+        eval_t lower_left = 0, upper_left = 0, lower_right = 0,
+               upper_right = 0;
+        for (int x = 0; x < eval_row_table::ROW_SIZE; ++x) {
+            const int row = int(bits >> (16 * x)) & 0xFFFF;
+            const int rev = row_table::reverse_row(row);
+            const int rx = eval_row_table::ROW_SIZE - 1 - x;
+            lower_right += table.sum[x][row];
+            lower_left += table.sum[x][rev];
+            upper_right += table.sum[rx][row];
+            upper_left += table.sum[rx][rev];
+        }
         return std::max({lower_left, upper_left, lower_right, upper_right});
     }
 };
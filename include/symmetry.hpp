@@ -0,0 +1,100 @@
+#pragma once
+#include <cstdint>
+#include <utility>
+
+#include "coord.hpp"
+
+namespace core {
+// The eight symmetries of a square board. Bit 0 of a symmetry mirrors the
+// columns (y -> size - 1 - y), bit 1 mirrors the rows, and bit 2 then swaps
+// x and y; the first four are the mirrors alone. A position and its image
+// play the same once moves are mapped along, so the solver can search and
+// cache one representative per class.
+struct symmetry {
+    static constexpr int COUNT = 8;
+    static constexpr int MIRRORS = 4;
+
+    // cell of the image that cell (x, y) of the original lands on
+    static constexpr std::pair<int, int> image_cell(int sym, int size, int x,
+                                                    int y) {
+        if (sym & 1) {
+            y = size - 1 - y;
+        }
+        if (sym & 2) {
+            x = size - 1 - x;
+        }
+        return sym & 4 ? std::pair{y, x} : std::pair{x, y};
+    }
+
+    // cell of the original that lands on cell (x, y) of the image
+    static constexpr std::pair<int, int> source_cell(int sym, int size, int x,
+                                                     int y) {
+        if (sym & 4) {
+            std::swap(x, y);
+        }
+        return {sym & 2 ? size - 1 - x : x, sym & 1 ? size - 1 - y : y};
+    }
+
+    // move on the image equivalent to `dir` on the original
+    static constexpr int map_move(int sym, int dir) {
+        // left and right are even, down and up odd
+        if ((sym & 1) && dir % 2 == 0) {
+            dir ^= 2;
+        }
+        if ((sym & 2) && dir % 2 == 1) {
+            dir ^= 2;
+        }
+        return sym & 4 ? 3 - dir : dir;  // left <-> up, down <-> right
+    }
+
+    // move on the original equivalent to `dir` on the image
+    static constexpr int unmap_move(int sym, int dir) {
+        if (sym & 4) {
+            dir = 3 - dir;
+        }
+        if ((sym & 1) && dir % 2 == 0) {
+            dir ^= 2;
+        }
+        if ((sym & 2) && dir % 2 == 1) {
+            dir ^= 2;
+        }
+        return dir;
+    }
+
+    // Image of the tiles of `board` under `sym`; the score is kept.
+    template <typename Board>
+    static Board apply(const Board& board, int sym) {
+        Board image = board;
+        const int size = board.size();
+        for (int x = 0; x < size; ++x) {
+            for (int y = 0; y < size; ++y) {
+                const auto [ix, iy] = image_cell(sym, size, x, y);
+                image.set_tile(ix, iy, board.get_tile(x, y));
+            }
+        }
+        return image;
+    }
+
+    // The symmetry among the first `count` whose image is least, comparing
+    // tiles in cell order, so every image of a board picks the same
+    // representative. Comparisons stop at the first differing cell.
+    template <typename Board>
+    static int canonical(const Board& board, int count) {
+        const int size = board.size();
+        int best = 0;
+        for (int sym = 1; sym < count; ++sym) {
+            for (int x = 0, diff = 0; x < size && diff == 0; ++x) {
+                for (int y = 0; y < size && diff == 0; ++y) {
+                    const auto [bx, by] = source_cell(best, size, x, y);
+                    const auto [sx, sy] = source_cell(sym, size, x, y);
+                    diff = board.get_tile(sx, sy) - board.get_tile(bx, by);
+                    if (diff < 0) {
+                        best = sym;
+                    }
+                }
+            }
+        }
+        return best;
+    }
+};
+}  // namespace core
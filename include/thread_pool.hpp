@@ -0,0 +1,77 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace core {
+// Fixed-size pool of worker threads fed from a single FIFO queue.
+class thread_pool {
+   public:
+    explicit thread_pool(int threads) {
+        threads = std::max(1, threads);
+        workers.reserve(threads);
+        for (int i = 0; i < threads; ++i) {
+            workers.emplace_back([this] { work(); });
+        }
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    ~thread_pool() {
+        {
+            std::lock_guard lock(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    template <typename F>
+    std::future<std::invoke_result_t<F>> submit(F f) {
+        using result_t = std::invoke_result_t<F>;
+        auto task = std::make_shared<std::packaged_task<result_t()>>(
+            std::move(f));
+        std::future<result_t> result = task->get_future();
+        {
+            std::lock_guard lock(mtx);
+            tasks.emplace([task] { (*task)(); });
+        }
+        cv.notify_one();
+        return result;
+    }
+
+    int size() const { return int(workers.size()); }
+
+   private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool stopping = false;
+
+    void work() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock lock(mtx);
+                cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty()) {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+};
+}  // namespace core
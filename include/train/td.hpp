@@ -0,0 +1,72 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+
+#include "bitboard.hpp"
+#include "ntuple.hpp"
+#include "rng.hpp"
+
+namespace train {
+struct td_game {
+    uint64_t score = 0;
+    int max_tile = 0;
+    int moves = 0;
+};
+
+// Plays one game greedily on the network's afterstate values, one ply deep,
+// and learns from it with TD(0): after each move, the value of the previous
+// afterstate moves `alpha` of the way towards the move's score plus the
+// value of the new afterstate, and towards 0 once the game is over.
+inline td_game learn_game(core::ntuple_network& network, float alpha,
+                          core::rng& engine) {
+    core::bitboard board;
+    board.add_random_tile(engine);
+    board.add_random_tile(engine);
+
+    td_game game;
+    bool has_previous = false;
+    core::bitboard::raw_t previous = 0;
+    while (true) {
+        core::bitboard best;
+        float best_value = 0;
+        bool moved = false;
+        for (int dir = core::direction::left; dir < 4; ++dir) {
+            core::bitboard after = board;
+            after.move(dir);
+            if (after == board) {
+                continue;
+            }
+            const float gain = float(after.get_score() - board.get_score());
+            const float value = gain + network.value(after.raw());
+            if (!moved || value > best_value) {
+                best = after;
+                best_value = value;
+                moved = true;
+            }
+        }
+        if (!moved) {
+            break;
+        }
+        if (has_previous) {
+            network.update(previous,
+                           alpha * (best_value - network.value(previous)));
+        }
+        previous = best.raw();
+        has_previous = true;
+        board = best;
+        board.add_random_tile(engine);
+        ++game.moves;
+    }
+    if (has_previous) {
+        network.update(previous, alpha * -network.value(previous));
+    }
+
+    game.score = board.get_score();
+    for (int x = 0; x < board.size(); ++x) {
+        for (int y = 0; y < board.size(); ++y) {
+            game.max_tile = std::max(game.max_tile, board.get_tile(x, y));
+        }
+    }
+    return game;
+}
+}  // namespace train
@@ -0,0 +1,133 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "hash.hpp"
+
+namespace core {
+// Fixed-size, open-addressed transposition table. Buckets are one cache line
+// of four 16-byte entries, so a probe touches a single line. Entries are
+// written without locks: each slot stores `key ^ data` next to `data`, and a
+// torn write simply fails the key check on the next probe.
+//
+// Stored values keep their low 4 bits for the search depth, which drives
+// depth-preferred replacement; the top 8 bits are reserved for the
+// generation the entry was written in. Entries older than MAX_AGE
+// generations count as empty, so nothing is ever erased explicitly.
+class transposition_table {
+   public:
+    static constexpr int BUCKET_SIZE = 4;
+    static constexpr size_t ENTRY_BYTES = 16;
+    static constexpr int MAX_AGE = 2;
+    static constexpr int GENERATION_SHIFT = 56;
+    static constexpr uint64_t VALUE_MASK = (1ULL << GENERATION_SHIFT) - 1;
+
+    explicit transposition_table(size_t bytes) { resize(bytes); }
+
+    // Rounds down to a power of two number of buckets, at least one.
+    void resize(size_t bytes) {
+        const size_t count = std::bit_floor(
+            std::max<size_t>(1, bytes / sizeof(bucket)));
+        buckets = std::make_unique<bucket[]>(count);
+        mask = count - 1;
+    }
+
+    void clear() {
+        for (size_t i = 0; i <= mask; ++i) {
+            for (auto& slot : buckets[i].slots) {
+                slot.check.store(0, std::memory_order_relaxed);
+                slot.data.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Call between searches; entries age by one generation.
+    void new_generation() { generation = (generation + 1) & 0xFF; }
+
+    int get_generation() const { return generation; }
+
+    // Entries of later generations count as empty until it comes back.
+    void set_generation(int value) { generation = value & 0xFF; }
+
+    bool probe(uint64_t key, uint64_t& value) const {
+        const bucket& b = bucket_of(key);
+        for (auto& slot : b.slots) {
+            const uint64_t data = slot.data.load(std::memory_order_relaxed);
+            const uint64_t check = slot.check.load(std::memory_order_relaxed);
+            if (data != 0 && (check ^ data) == key && !stale(data)) {
+                value = data & VALUE_MASK;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Returns true when the write dropped a live entry of another position.
+    bool store(uint64_t key, uint64_t value) {
+        bucket& b = bucket_of(key);
+        const int depth = int(value & 0xF);
+        entry* victim = nullptr;
+        int victim_priority = 0;
+        bool evicts = false;
+        for (auto& slot : b.slots) {
+            const uint64_t data = slot.data.load(std::memory_order_relaxed);
+            const uint64_t check = slot.check.load(std::memory_order_relaxed);
+            if (data != 0 && (check ^ data) == key) {
+                // same position: keep a deeper result from this generation
+                if (!stale(data) && age(data) == 0 && int(data & 0xF) > depth) {
+                    return false;
+                }
+                victim = &slot;
+                evicts = false;
+                break;
+            }
+            // empty and stale slots go first, then the shallowest entry
+            const bool live = data != 0 && !stale(data);
+            const int priority = live ? int(data & 0xF) - age(data) : -1;
+            if (victim == nullptr || priority < victim_priority) {
+                victim = &slot;
+                victim_priority = priority;
+                evicts = live;
+            }
+        }
+        const uint64_t data =
+            (value & VALUE_MASK) | (uint64_t(generation) << GENERATION_SHIFT);
+        victim->data.store(data, std::memory_order_relaxed);
+        victim->check.store(key ^ data, std::memory_order_relaxed);
+        return evicts;
+    }
+
+    size_t capacity() const { return (mask + 1) * BUCKET_SIZE; }
+
+    size_t memory() const { return (mask + 1) * sizeof(bucket); }
+
+   private:
+    struct entry {
+        std::atomic<uint64_t> check{0};
+        std::atomic<uint64_t> data{0};
+    };
+    struct alignas(64) bucket {
+        entry slots[BUCKET_SIZE];
+    };
+    static_assert(sizeof(entry) == ENTRY_BYTES && sizeof(bucket) == 64);
+
+    std::unique_ptr<bucket[]> buckets;
+    size_t mask = 0;
+    int generation = 0;
+
+    int age(uint64_t data) const {
+        return (generation - int(data >> GENERATION_SHIFT)) & 0xFF;
+    }
+
+    bool stale(uint64_t data) const { return age(data) > MAX_AGE; }
+
+    bucket& bucket_of(uint64_t key) const {
+        // the caller's key may be a raw packed board
+        return buckets[fmix64(key) & mask];
+    }
+};
+}  // namespace core
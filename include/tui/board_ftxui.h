@@ -1,17 +1,33 @@
 ﻿#pragma once
 #include <ftxui/component/component.hpp>
 #include <ftxui/component/event.hpp>
+#include <ftxui/component/screen_interactive.hpp>
 #include <ftxui/dom/elements.hpp>
 #include <ftxui/screen/color.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <functional>
 #include <future>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "board_2048.hpp"
+#include "game_history.hpp"
+#include "game_record.hpp"
 #include "solver.hpp"
 
 namespace tui {
 using namespace ftxui::literals;
 namespace colors {
-inline ftxui::Color color_of(int tile_number) {
+// Colour of a tile; tiles above 2048 get one drawn from rand() seeded with
+// the tile, so use color_of.
+inline ftxui::Color make_color(int tile_number) {
     using namespace ftxui;
     switch (tile_number) {
         case 2:
@@ -42,11 +58,14 @@ inline ftxui::Color color_of(int tile_number) {
             int baseGreen = 180;
             int baseBlue = 0;
 
+            // the products wrap around for large tiles
             double factor1 =
-                std::log2(tile_number * rand() / RAND_MAX) / std::log2(2048);
+                std::log2(int(int64_t(tile_number) * rand()) / RAND_MAX) /
+                std::log2(2048);
             factor1 = std::abs(std::tanh(factor1));
             double factor2 =
-                std::log2(tile_number * rand() / RAND_MAX) / std::log2(2048);
+                std::log2(int(int64_t(tile_number) * rand()) / RAND_MAX) /
+                std::log2(2048);
             factor2 = std::abs(std::tanh(factor2));
 
             int r = static_cast<int>(baseRed * factor1);
@@ -57,6 +76,21 @@ inline ftxui::Color color_of(int tile_number) {
             break;
     }
 }
+
+// make_color, computed once per power of two
+inline ftxui::Color color_of(int tile_number) {
+    static const std::array<ftxui::Color, 31> palette = [] {
+        std::array<ftxui::Color, 31> colors;
+        for (int e = 0; e < 31; ++e) {
+            colors[e] = make_color(1 << e);
+        }
+        return colors;
+    }();
+    if (tile_number > 0 && std::has_single_bit(unsigned(tile_number))) {
+        return palette[std::countr_zero(unsigned(tile_number))];
+    }
+    return make_color(tile_number);
+}
 inline ftxui::Color sep_col = 0xbbada0_rgb;
 inline ftxui::Color num_col = 0x776e65_rgb;
 inline ftxui::Color zero_col = 0xcdc1b4_rgb;
@@ -109,199 +143,129 @@ struct BoardOption {
         ftxui::animation::easing::Linear;
     ftxui::animation::Duration duration = std::chrono::milliseconds(250);
 };
-struct TileBase : ftxui::Node {
-    explicit TileBase(int number, int cell_size, ftxui::Color num_col)
-        : n(number), cell_size(cell_size), num_col(num_col) {}
-    void ComputeRequirement() override {
-        requirement_.min_x = cell_size * 2;
-        requirement_.min_y = cell_size;
-    }
-    void Render(ftxui::Screen& screen) override {
-        if (box_.x_max < box_.x_min) {
-            return;
-        }
-        for (int x = box_.x_min; x <= box_.x_max; ++x) {
-            for (int y = box_.y_min; y <= box_.y_max; ++y) {
-                screen.PixelAt(x, y).background_color = colors::color_of(n);
-            }
-        }
-        int midy = (box_.y_min + box_.y_max) / 2;
-        auto len = box_.x_max - box_.x_min + 1;
-        std::string number_str = std::to_string(n);
-        std::string nstr = std::string((len - number_str.size()) / 2, ' ') +
-                           number_str +
-                           std::string((len - number_str.size() + 1) / 2, ' ');
-        auto it = nstr.begin();
-        for (int x = box_.x_min; x <= box_.x_max; ++x) {
-            auto& pixel = screen.PixelAt(x, midy);
-            pixel.character = *it++;
-            pixel.foreground_color = num_col;
+// A tile as drawn at one cell width: its colour and its number centred in
+// that many characters.
+struct TileGlyph {
+    ftxui::Color background;
+    std::string label;
+};
+
+// Glyphs of the tiles drawn at one cell size, made on first use.
+class TileCache {
+   public:
+    explicit TileCache(int cell_size = 1) : width(cell_size * 2) {}
+
+    const TileGlyph& Get(int tile_number) {
+        auto [it, inserted] = glyphs.try_emplace(tile_number);
+        if (inserted) {
+            std::string number = std::to_string(tile_number);
+            number.resize(std::min(number.size(), size_t(width)));
+            const int pad = width - int(number.size());
+            it->second = {colors::color_of(tile_number),
+                          std::string(pad / 2, ' ') + number +
+                              std::string(pad - pad / 2, ' ')};
         }
+        return it->second;
     }
 
    private:
-    int n;
-    int cell_size;
-    ftxui::Color num_col;
+    int width;
+    std::unordered_map<int, TileGlyph> glyphs;
 };
-struct TileRowBase : ftxui::Node {
-    explicit TileRowBase(std::vector<float> tiles_pos,
-                         std::vector<int> tile_numbers, int row_len,
-                         int tile_size, int sep_size = 1)
-        : tile_start(std::move(tiles_pos)),
-          tiles(std::move(tile_numbers)),
-          tile_size(tile_size),
-          length(row_len),
-          sep_size(sep_size) {
-        using namespace ftxui;
-        auto zero_e = [this] {
-            return text(" ") | ftxui::size(HEIGHT, EQUAL, this->tile_size) |
-                   ftxui::size(WIDTH, EQUAL, this->tile_size * 2) |
-                   bgcolor(colors::zero_col);
-        };
-        auto sep_e = [this] {
-            return text(" ") | ftxui::size(HEIGHT, EQUAL, this->tile_size) |
-                   ftxui::size(WIDTH, EQUAL, this->sep_size * 2) |
-                   bgcolor(colors::sep_col);
-        };
-        Elements es;
-        es.reserve(2 * length - 1);
-        es.push_back(zero_e());
-        for (int i = 1; i < length; ++i) {
-            es.push_back(sep_e());
-            es.push_back(zero_e());
-        }
-        children_.push_back(hbox(es));
-    }
 
-    void ComputeRequirement() override {
-        Node::ComputeRequirement();
-        requirement_ = children_[0]->requirement();
-    }
-    void SetBox(ftxui::Box box) override {
-        Node::SetBox(box);
-        children_[0]->SetBox(ftxui::Box{
-            .x_min = box_.x_min,
-            .x_max = box_.x_min + requirement_.min_x - 1,
-            .y_min = box_.y_min,
-            .y_max = box_.y_min + requirement_.min_y - 1,
-        });
-    }
-    void Render(ftxui::Screen& screen) override {
-        using namespace ftxui;
-        Node::Render(screen);
-        if (box_.x_max < box_.x_min) {
-            return;
-        }
-        for (int i = 0; i < tiles.size(); ++i) {
-            auto tile = tile_element(tiles[i]);
-            int start_x = box_.x_min + int(std::round(tile_start[i])),
-                start_y = box_.y_min;
-            tile->SetBox(Box{.x_min = start_x,
-                             .x_max = start_x + tile_size * 2 - 1,
-                             .y_min = start_y,
-                             .y_max = start_y + tile_size - 1});
-            tile->Render(screen);
+// Paints a tile `height` cells high with its top left corner at (x, y).
+inline void paint_tile(ftxui::Screen& screen, const TileGlyph& glyph, int x,
+                       int y, int height) {
+    const int width = int(glyph.label.size());
+    for (int dy = 0; dy < height; ++dy) {
+        for (int dx = 0; dx < width; ++dx) {
+            screen.PixelAt(x + dx, y + dy).background_color =
+                glyph.background;
         }
     }
-
-   private:
-    ftxui::Element tile_element(int tile_number) const {
-        using namespace ftxui;
-        return Make<TileBase>(tile_number, tile_size, colors::num_col);
+    for (int dx = 0; dx < width; ++dx) {
+        auto& pixel = screen.PixelAt(x + dx, y + (height - 1) / 2);
+        pixel.character = glyph.label[dx];
+        pixel.foreground_color = colors::num_col;
     }
-    std::vector<float> tile_start;
-    std::vector<int> tiles;
-    int length;
-    int tile_size;
-    int sep_size;
-};
-struct TileColBase : ftxui::Node {
-    explicit TileColBase(std::vector<float> tiles_pos,
-                         std::vector<int> tile_numbers, int row_len,
-                         int tile_size, int sep_size = 1)
-        : tile_start(std::move(tiles_pos)),
-          tiles(std::move(tile_numbers)),
-          tile_size(tile_size),
+}
+
+// A row (Vertical = false) or column of the board while a move animates:
+// the empty cells and the gaps between them, then the tiles of `tiles`,
+// each `progress` of the way from its cell to its target. The node only
+// refers to both, so it is built once and drawn in every frame.
+template <bool Vertical>
+struct TileLineBase : ftxui::Node {
+    using Tiles = std::vector<std::tuple<int, float, float>>;
+
+    TileLineBase(const Tiles& tiles, const float& progress, TileCache& cache,
+                 int row_len, int tile_size, int sep_size = 1)
+        : tiles(tiles),
+          progress(progress),
+          cache(cache),
           length(row_len),
-          sep_size(sep_size) {
-        using namespace ftxui;
-        auto zero_e = [this] {
-            return text(" ") | ftxui::size(HEIGHT, EQUAL, this->tile_size) |
-                   ftxui::size(WIDTH, EQUAL, this->tile_size * 2) |
-                   bgcolor(colors::zero_col);
-        };
-        auto sep_e = [this] {
-            return text(" ") | ftxui::size(HEIGHT, EQUAL, this->sep_size) |
-                   ftxui::size(WIDTH, EQUAL, this->tile_size * 2) |
-                   bgcolor(colors::sep_col);
-        };
-        Elements es;
-        es.reserve(2 * length - 1);
-        es.push_back(zero_e());
-        for (int i = 1; i < length; ++i) {
-            es.push_back(sep_e());
-            es.push_back(zero_e());
-        }
-        children_.push_back(vbox(es));
-    }
+          tile_size(tile_size),
+          sep_size(sep_size) {}
 
     void ComputeRequirement() override {
-        Node::ComputeRequirement();
-        requirement_ = children_[0]->requirement();
+        const int along =
+            length * tile_size + (length - 1) * sep_size;  // in cells
+        requirement_.min_x = Vertical ? tile_size * 2 : along * 2;
+        requirement_.min_y = Vertical ? along : tile_size;
     }
 
-    void SetBox(ftxui::Box box) override {
-        Node::SetBox(box);
-        children_[0]->SetBox(ftxui::Box{
-            .x_min = box_.x_min,
-            .x_max = box_.x_min + requirement_.min_x - 1,
-            .y_min = box_.y_min,
-            .y_max = box_.y_min + requirement_.min_y - 1,
-        });
-    }
     void Render(ftxui::Screen& screen) override {
-        using namespace ftxui;
-        Node::Render(screen);
-        if (box_.y_max < box_.y_min) {
+        if (box_.x_max < box_.x_min || box_.y_max < box_.y_min) {
             return;
         }
-        for (int i = 0; i < tiles.size(); ++i) {
-            auto tile = tile_element(tiles[i]);
-            int start_y = box_.y_min + int(std::round(tile_start[i])),
-                start_x = box_.x_min;
-            tile->SetBox(Box{.x_min = start_x,
-                             .x_max = start_x + tile_size * 2 - 1,
-                             .y_min = start_y,
-                             .y_max = start_y + tile_size - 1});
-            tile->Render(screen);
+        // characters per cell along the line
+        const int scale = Vertical ? 1 : 2;
+        const int pitch = (tile_size + sep_size) * scale;
+        for (int y = 0; y < requirement_.min_y; ++y) {
+            for (int x = 0; x < requirement_.min_x; ++x) {
+                const int along = Vertical ? y : x;
+                screen.PixelAt(box_.x_min + x, box_.y_min + y)
+                    .background_color = along % pitch < tile_size * scale
+                                            ? colors::zero_col
+                                            : colors::sep_col;
+            }
+        }
+        for (const auto& [tile, from, to] : tiles) {
+            const int offset =
+                int(std::round(pitch * std::lerp(from, to, progress)));
+            paint_tile(screen, cache.Get(tile),
+                       box_.x_min + (Vertical ? 0 : offset),
+                       box_.y_min + (Vertical ? offset : 0), tile_size);
         }
     }
 
    private:
-    ftxui::Element tile_element(int tile_number) const {
-        using namespace ftxui;
-        return Make<TileBase>(tile_number, tile_size, colors::num_col);
-        /*static auto cell_size_style = ftxui::size(HEIGHT, EQUAL, tile_size) |
-        ftxui::size(WIDTH, EQUAL, tile_size * 2); return
-        text(std::to_string(tile_number)) | cell_size_style | color(num_col) |
-        bgcolor(colors::color_of(tile_number));*/
-    }
-    std::vector<float> tile_start;
-    std::vector<int> tiles;
+    const Tiles& tiles;
+    const float& progress;
+    TileCache& cache;
     int length;
     int tile_size;
     int sep_size;
 };
+using TileRowBase = TileLineBase<false>;
+using TileColBase = TileLineBase<true>;
+
 class BoardBase : public ftxui::ComponentBase {
    public:
     explicit BoardBase(core::board_2048& board_ref, const BoardOption& options)
-        : option(options), board(board_ref) {
+        : option(options),
+          board(board_ref),
+          history(board_ref, solver.get_cache_generation()) {
         board.brd_size = option.board_size;
         pre_board = board;
-        animate_value_and_target.resize(options.board_size);
+        BuildViews();
     };
 
+    ~BoardBase() override {
+        CancelSearch();
+        EndRecord();
+    }
+
     void OnAnimation(ftxui::animation::Params& params) override {
         if (animator_main.to() != 0.0f) {
             animator_main.OnAnimation(params);
@@ -315,6 +279,9 @@ class BoardBase : public ftxui::ComponentBase {
                 TakeFocus();
             }
         }
+        if (replay && e != Event::Special("reset_board")) {
+            return OnReplayEvent(e);
+        }
         int dir = -1;
         if (e == Event::ArrowUp || e == Event::w) {
             dir = core::direction::up;
@@ -324,33 +291,59 @@ class BoardBase : public ftxui::ComponentBase {
             dir = core::direction::left;
         } else if (e == Event::ArrowRight || e == Event::d) {
             dir = core::direction::right;
+        } else if (e == Event::Character("u")) {
+            return Undo();
+        } else if (e == Event::Character("r")) {
+            return Redo();
         } else if (e == Event::Special("reset_board")) {
+            CancelSearch();
+            EndRecord();
+            replay = nullptr;
+            replay_moves = replay_move = 0;
             board = core::board_2048(option.board_size);
-            animate_value_and_target.clear();
-            animate_value_and_target.resize(option.board_size);
+            history = core::game_history(board, solver.get_cache_generation());
+            BeginRecord();
+            BuildViews();
+            StartSearch();
             return true;
         } else if (e == Event::Special("automatic_move")) {
-            if (automatic_move) {
-                dir = solver.get_best_move(board);
-            } else {
+            // OnRender posts this again once the animation is over
+            if (!automatic_move || animation_progress != 1.0f) {
+                return true;
+            }
+            if (search_result == -1) {
+                StartSearch();
                 return true;
             }
+            dir = std::exchange(search_result, -1);
         }
 
         if (dir != -1) {
             if (animation_progress == 1.0f) {
                 if (board.valid_move(dir)) {
+                    CancelSearch();  // searched a board that is now stale
                     animation_progress = 0.0f;
                     pre_board = board;
-                    board.move_record(dir);
+                    tile_moves.clear();
+                    board.move(dir, tile_moves);
                     animate_direction = dir;
                     UpdateAnimationTarget(animate_direction);
-                    board.add_random_tile();
+                    const int cell = board.add_random_tile();
+                    const int tile = board.get_tile(cell / board.size(),
+                                                    cell % board.size());
+                    history.push(board, dir, cell, tile,
+                                 solver.get_cache_generation());
+                    Record([&] {
+                        recorder->add(dir, cell, tile);
+                    });
                 }
                 if (board.is_over()) {
                     ScreenInteractive::Active()->PostEvent(
                         Event::Special("gameover"));
                     automatic_move = false;
+                    EndRecord();
+                } else {
+                    StartSearch();  // runs while the move animates
                 }
             }
             return true;
@@ -361,66 +354,60 @@ class BoardBase : public ftxui::ComponentBase {
 
     ftxui::Element OnRender() override {
         using namespace ftxui;
-        Element ret;
-        if (animation_progress == 1.0f) {
-            ret = board_view_2048(board, option.cell_size);
-            if (automatic_move) {
-                ScreenInteractive::Active()->PostEvent(
-                    Event::Special("automatic_move"));
-            }
-        } else {
-            if (animate_direction % 2 == 0) {
-                Elements rows;
-                std::vector<float> tile_pos;
-                std::vector<int> tile_numbers;
-                for (auto& vec : animate_value_and_target) {
-                    for (auto& tp : vec) {
-                        tile_numbers.push_back(std::get<0>(tp));
-                        tile_pos.push_back(
-                            (option.cell_size + option.sep_size) * 2 *
-                            std::lerp(std::get<1>(tp), std::get<2>(tp),
-                                      animation_progress));
-                    }
-                    rows.push_back(Make<TileRowBase>(
-                        tile_pos, tile_numbers, option.board_size,
-                        option.cell_size, option.sep_size));
-                    rows.push_back(separatorEmpty() |
-                                   size(HEIGHT, EQUAL, option.sep_size) |
-                                   bgcolor(colors::sep_col));
-                    tile_numbers.clear();
-                    tile_pos.clear();
-                }
-                rows.pop_back();
-                ret = vbox(rows) | borderRounded | bgcolor(colors::sep_col);
-            } else {
-                Elements cols;
-                std::vector<float> tile_pos;
-                std::vector<int> tile_numbers;
-                for (auto& vec : animate_value_and_target) {
-                    for (auto& tp : vec) {
-                        tile_numbers.push_back(std::get<0>(tp));
-                        tile_pos.push_back(
-                            (option.cell_size + option.sep_size) *
-                            std::lerp(std::get<1>(tp), std::get<2>(tp),
-                                      animation_progress));
-                    }
-                    cols.push_back(Make<TileColBase>(
-                        tile_pos, tile_numbers, option.board_size,
-                        option.cell_size, option.sep_size));
-                    cols.push_back(separatorEmpty() |
-                                   size(WIDTH, EQUAL, option.sep_size * 2) |
-                                   bgcolor(colors::sep_col));
-                    tile_pos.clear();
-                    tile_numbers.clear();
-                }
-                cols.pop_back();
-                ret = hbox(cols) | borderRounded | bgcolor(colors::sep_col);
+        if (animation_progress != 1.0f) {
+            return animate_direction % 2 == 0 ? row_view : col_view;
+        }
+        if (automatic_move && search_result != -1) {
+            ScreenInteractive::Active()->PostEvent(
+                Event::Special("automatic_move"));
+        }
+        // rebuilt only when the board changes
+        if (!board_view || board.hash() != board_view_hash) {
+            board_view = Framed(board_view_2048(board, option.cell_size));
+            board_view_hash = board.hash();
+        }
+        return board_view;
+    }
+
+    // The animation views are built once for the board and cell size and
+    // only read the animation state when drawn.
+    void BuildViews() {
+        using namespace ftxui;
+        animate_value_and_target.clear();
+        animate_value_and_target.resize(option.board_size);
+        tile_cache = TileCache(option.cell_size);
+        Elements rows, cols;
+        for (const auto& line : animate_value_and_target) {
+            if (!rows.empty()) {
+                rows.push_back(separatorEmpty() |
+                               size(HEIGHT, EQUAL, option.sep_size) |
+                               bgcolor(colors::sep_col));
+                cols.push_back(separatorEmpty() |
+                               size(WIDTH, EQUAL, option.sep_size * 2) |
+                               bgcolor(colors::sep_col));
             }
+            rows.push_back(Make<TileRowBase>(line, animation_progress,
+                                             tile_cache, option.board_size,
+                                             option.cell_size,
+                                             option.sep_size));
+            cols.push_back(Make<TileColBase>(line, animation_progress,
+                                             tile_cache, option.board_size,
+                                             option.cell_size,
+                                             option.sep_size));
         }
+        row_view =
+            Framed(vbox(rows) | borderRounded | bgcolor(colors::sep_col));
+        col_view =
+            Framed(hbox(cols) | borderRounded | bgcolor(colors::sep_col));
+        board_view = nullptr;
+    }
+
+    ftxui::Element Framed(ftxui::Element view) {
+        using namespace ftxui;
         int col_size =
             (option.cell_size + option.sep_size) * option.board_size -
             option.sep_size;
-        return ret | size(WIDTH, EQUAL, col_size * 2 + 2) |
+        return view | size(WIDTH, EQUAL, col_size * 2 + 2) |
                size(HEIGHT, EQUAL, col_size) | reflect(box_);
     }
 
@@ -431,49 +418,292 @@ class BoardBase : public ftxui::ComponentBase {
             &animation_progress, 1, option.duration, option.move_func);
         using namespace ftxui;
 
-        auto brd_sz = board.size();
-        for (int i = 0; i < animate_value_and_target.size(); ++i) {
-            animate_value_and_target[i].clear();
+        // rows move for left and right, columns for up and down
+        const int brd_sz = board.size();
+        const bool rows = dir % 2 == 0;
+        for (auto& line : animate_value_and_target) {
+            line.clear();
         }
-        for (int x = 0; x < brd_sz; ++x) {
-            for (int y = 0; y < brd_sz; ++y) {
-                auto& p = board.records[x * brd_sz + y];
-                if (p.first != 0) {
-                    if (dir == core::direction::left) {
-                        int ay = p.second % brd_sz;
-                        animate_value_and_target[x].push_back({p.first, y, ay});
-                    } else if (dir == core::direction::right) {
-                        int ay = brd_sz - 1 - p.second % brd_sz;
-                        animate_value_and_target[brd_sz - 1 - x].push_back(
-                            {p.first, brd_sz - 1 - y, ay});
-                    } else if (dir == core::direction::down) {
-                        int ay = brd_sz - 1 - p.second % brd_sz;
-                        animate_value_and_target[x].push_back(
-                            {p.first, brd_sz - 1 - y, ay});
-                    } else if (dir == core::direction::up) {
-                        int ay = p.second % brd_sz;
-                        animate_value_and_target[brd_sz - 1 - x].push_back(
-                            {p.first, y, ay});
-                    }
-                }
+        for (const core::tile_move& m : tile_moves) {
+            const int tile = pre_board.get_tile(m.from / brd_sz,
+                                                m.from % brd_sz);
+            if (rows) {
+                animate_value_and_target[m.from / brd_sz].push_back(
+                    {tile, m.from % brd_sz, m.to % brd_sz});
+            } else {
+                animate_value_and_target[m.from % brd_sz].push_back(
+                    {tile, m.from / brd_sz, m.to / brd_sz});
             }
         }
     }
+
+    void SetAutomaticMove(bool enabled) {
+        automatic_move = enabled && !replay;
+        if (enabled) {
+            StartSearch();
+        } else if (!show_hints) {
+            CancelSearch();
+        }
+    }
+
+    // Searches every position reached for Hint(), also without automatic
+    // play.
+    void SetHints(bool enabled) {
+        show_hints = enabled;
+        if (enabled) {
+            StartSearch();
+        } else if (!automatic_move) {
+            CancelSearch();
+        }
+    }
+
+    // Values of the moves from the board shown, refreshed after each depth
+    // the background search completes; empty (best_move -1) until the first.
+    const core::solver::analysis& Hint() const { return hint; }
+
+    // Rebuilds the views, which are laid out for one cell size, and drops
+    // the board view cached; a move animating ends.
+    void SetCellSize(int cell_size) {
+        option.cell_size = cell_size;
+        StopAnimation();
+        BuildViews();
+    }
+
+    // Streams the games played from now on to `writer`, starting with the
+    // current board; nullptr stops recording.
+    void SetRecorder(std::shared_ptr<core::record_writer> writer) {
+        EndRecord();
+        recorder = std::move(writer);
+        BeginRecord();
+    }
+
+    // Steps back or forward through the moves played, without limit until
+    // a new move drops those undone. The solver resumes with the results it
+    // searched at that position. A recorded game ends at an undo and a new
+    // one starts from the position reached.
+    bool Undo() { return Rewind(history.position() - 1); }
+
+    bool Redo() { return Rewind(history.position() + 1); }
+
+    // Shows a recorded game from its start instead of playing: right and
+    // left step through its moves, Page Down and Page Up skip a keyframe
+    // interval, Home and End jump to either end. Automatic play and
+    // recording stop until the reset that leaves the replay.
+    void StartReplay(std::shared_ptr<core::game_replay> game) {
+        CancelSearch();
+        automatic_move = false;
+        EndRecord();
+        replay = std::move(game);
+        option.board_size = replay->board().size();
+        BuildViews();
+        replay_moves = replay->size();
+        ShowReplay();
+    }
+
+    // Jumps to the position after `index` moves of the replay.
+    void SeekReplay(int index) {
+        if (!replay) {
+            return;
+        }
+        const int before = replay->index();
+        replay->seek(index);
+        if (replay->index() != before) {
+            ShowReplay();
+        }
+    }
+
+    bool Replaying() const { return replay != nullptr; }
+
+    // The solver must not be reconfigured while it searches.
+    void ConfigureSolver(const std::function<void(core::solver&)>& configure) {
+        CancelSearch();
+        configure(solver);
+        StartSearch();
+    }
+
+    // Stops the background search and drops its move. Only waits for the
+    // search to notice, which takes a few nodes.
+    void CancelSearch() {
+        search_cancelled = true;
+        if (search.valid()) {
+            search.wait();
+            search = {};
+        }
+        search_result = -1;
+        hint = {};
+        ++search_id;
+    }
+
+    // Of the last finished background search; read on the UI thread.
+    const core::solver::stats& LastSearchStats() const { return search_stats; }
+
     BoardOption option;
     bool automatic_move = false;
+    // moves played in the replay shown and in the whole game; the replay
+    // slider sets replay_move, then calls SeekReplay with it
+    int replay_move = 0;
+    int replay_moves = 0;
     core::solver solver;
 
    private:
+    // The replay's position, without animation.
+    void ShowReplay() {
+        board = replay->board();
+        replay_move = replay->index();
+        StopAnimation();
+    }
+
+    void StopAnimation() {
+        animator_main = ftxui::animation::Animator(&animation_progress);
+        animation_progress = 1.0f;
+    }
+
+    bool Rewind(int position) {
+        if (replay || position < 0 || position > history.size()) {
+            return false;
+        }
+        CancelSearch();
+        EndRecord();
+        history.seek(position, board);
+        solver.set_cache_generation(history.generation());
+        StopAnimation();
+        BeginRecord();
+        StartSearch();
+        return true;
+    }
+
+    bool OnReplayEvent(const ftxui::Event& e) {
+        using namespace ftxui;
+        if (e == Event::ArrowRight || e == Event::d) {
+            if (animation_progress != 1.0f) {
+                // keys repeat faster than moves animate
+                SeekReplay(replay_move + 1);
+            } else if (replay_move < replay_moves) {
+                pre_board = board;
+                tile_moves.clear();
+                replay->step(tile_moves);
+                board = replay->board();
+                replay_move = replay->index();
+                animation_progress = 0.0f;
+                animate_direction = replay->move(replay_move - 1).dir;
+                UpdateAnimationTarget(animate_direction);
+            }
+        } else if (e == Event::ArrowLeft || e == Event::a) {
+            SeekReplay(replay_move - 1);
+        } else if (e == Event::PageDown) {
+            SeekReplay(replay_move + core::game_replay::KEYFRAME_INTERVAL);
+        } else if (e == Event::PageUp) {
+            SeekReplay(replay_move - core::game_replay::KEYFRAME_INTERVAL);
+        } else if (e == Event::Home) {
+            SeekReplay(0);
+        } else if (e == Event::End) {
+            SeekReplay(replay_moves);
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // Reseeds the spawns, so that the record's seed reproduces them; without
+    // a recorder the board keeps its own spawn sequence.
+    void BeginRecord() {
+        if (!recorder) {
+            return;
+        }
+        const uint64_t seed = core::random_seed();
+        board.seed(seed);
+        Record([&] {
+            recorder->begin(core::game_record(board, seed,
+                                              solver.settings_fingerprint(),
+                                              solver.get_depth()));
+        });
+    }
+
+    void EndRecord() {
+        Record([&] { recorder->end(board.get_score()); });
+    }
+
+    // Recording stops if the file can't be written.
+    template <typename Write>
+    void Record(Write&& write) {
+        if (!recorder) {
+            return;
+        }
+        try {
+            write();
+        } catch (const std::exception&) {
+            recorder = nullptr;
+        }
+    }
+
+    // Searches the current board on a worker thread; the move is posted back
+    // to the UI thread, followed by an "automatic_move" event to play it.
+    void StartSearch() {
+        using namespace ftxui;
+        if (!(automatic_move || show_hints) || replay || search.valid() ||
+            search_result != -1 || board.is_over()) {
+            return;
+        }
+        search_cancelled = false;
+        auto* screen = ScreenInteractive::Active();
+        auto task = [this, screen, position = board, id = search_id] {
+            // each depth completed refreshes the hint
+            const core::solver::analysis result = solver.analyze(
+                position, &search_cancelled,
+                [this, screen, id](const core::solver::analysis& partial) {
+                    screen->Post([this, id, partial] {
+                        if (id == search_id) {
+                            hint = partial;
+                        }
+                    });
+                    screen->PostEvent(Event::Custom);  // redraws
+                });
+            if (search_cancelled) {
+                return;
+            }
+            screen->Post([this, id, result, stats = solver.get_stats()] {
+                if (id == search_id) {  // not cancelled meanwhile
+                    search = {};
+                    // a time budget may run out before depth 1
+                    search_result =
+                        result.best_move != -1
+                            ? result.best_move
+                            : std::countr_zero(unsigned(result.legal_moves));
+                    search_stats = stats;
+                    hint = result;
+                }
+            });
+            screen->PostEvent(Event::Special("automatic_move"));
+        };
+        search = std::async(std::launch::async, std::move(task));
+    }
+
     ftxui::Box box_;
     core::board_2048& board;
     core::board_2048 pre_board;
+    core::game_history history;
+    std::vector<core::tile_move> tile_moves;  // of the move animating
     int animate_direction = core::direction::left;
     float animation_progress = 1.0f;
     ftxui::animation::Animator animator_main =
         ftxui::animation::Animator(&animation_progress);
     std::vector<std::vector<std::tuple<int, float, float>>>
         animate_value_and_target;
+    TileCache tile_cache;
+    ftxui::Element row_view, col_view;  // while a move animates
+    ftxui::Element board_view;  // of the board hashing to board_view_hash
+    uint64_t board_view_hash = 0;
+    std::future<void> search;
+    std::atomic<bool> search_cancelled = false;
+    int search_result = -1;  // move found for `board`, not played yet
+    uint64_t search_id = 0;  // bumped by CancelSearch to drop stale posts
+    core::solver::stats search_stats;
+    core::solver::analysis hint;  // of `board`, as deep as searched yet
+    bool show_hints = false;
+    std::shared_ptr<core::record_writer> recorder;
+    std::shared_ptr<core::game_replay> replay;  // shown instead of playing
 };
+
 using BoardCom = std::shared_ptr<BoardBase>;
 inline auto Board(core::board_2048& brd_ref,
                   BoardOption option = BoardOption{}) {
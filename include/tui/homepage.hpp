@@ -1,8 +1,14 @@
 ﻿#pragma once
 #include <ftxui/component/component.hpp>
 #include <ftxui/component/screen_interactive.hpp>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <thread>
 
 #include "board_ftxui.h"
+#include "evaluator.hpp"
+#include "game_record.hpp"
 
 namespace tui {
 struct HomePage {
@@ -27,9 +33,14 @@ struct HomePage {
         option.duration = std::chrono::milliseconds(125);
         option.board_size = 4;
         brd = tui::Board(board, option);
+#ifndef __EMSCRIPTEN__
+        brd->solver.set_threads(int(std::thread::hardware_concurrency()));
+#endif
+        brd->solver.set_evaluator(evaluator);
+        brd->SetRecorder(recorder);
         Component layout =
             Container::Horizontal({
-                brd,
+                Container::Vertical({brd, MoveHints()}),
                 Renderer([] { return separatorEmpty(); }),
                 Container::Vertical(
                     {Container::Horizontal({
@@ -40,6 +51,12 @@ struct HomePage {
                          ResetButton(),
                      }),
                      Ele(separatorEmpty()),
+                     Container::Horizontal({
+                         UndoButton(),
+                         Renderer([] { return separatorEmpty(); }),
+                         RedoButton(),
+                     }) | hcenter,
+                     Ele(separatorEmpty()),
                      Container::Horizontal({
                          BoardSizeInput() | borderEmpty |
                              bgcolor(colors::zero_col) | color(colors::num_col),
@@ -53,7 +70,13 @@ struct HomePage {
                      Container::Horizontal(
                          {SearchDepth() | vcenter,
                           Renderer([] { return separatorEmpty(); }),
-                          Text("Negative: automatic") | borderEmpty | vcenter}),
+                          Container::Vertical(
+                              {Text("Negative: automatic"),
+                               Text("e.g. 200ms: time per move")}) |
+                              borderEmpty | vcenter}),
+                     SearchStats(),
+                     Ele(separatorEmpty()),
+                     ReplayControls(),
                      Ele(separatorEmpty()),
                      Button("      Quit      ", screen.ExitLoopClosure(),
                             ButtonOption::Animated(colors::zero_col,
@@ -101,6 +124,29 @@ struct HomePage {
                       ButtonOption::Animated(0xeee4da_rgb, 0x776e65_rgb));
     }
 
+    // Also the u and r keys on the board.
+    ftxui::Component UndoButton() {
+        using namespace ftxui;
+        return Button(
+            "Undo",
+            [this] {
+                brd->Undo();
+                brd->TakeFocus();
+            },
+            ButtonOption::Animated(0xeee4da_rgb, 0x776e65_rgb));
+    }
+
+    ftxui::Component RedoButton() {
+        using namespace ftxui;
+        return Button(
+            "Redo",
+            [this] {
+                brd->Redo();
+                brd->TakeFocus();
+            },
+            ButtonOption::Animated(0xeee4da_rgb, 0x776e65_rgb));
+    }
+
     ftxui::Component ScoreRecord(std::string title) {
         using namespace ftxui;
         return Renderer([this, title] {
@@ -143,7 +189,7 @@ struct HomePage {
         auto option = InputOption::Default();
         option.on_enter = [this] {
             try {
-                brd->option.cell_size = std::max(1, std::stoi(cell_size));
+                brd->SetCellSize(std::max(1, std::stoi(cell_size)));
             } catch (const std::exception&) {
             }
             brd->TakeFocus();
@@ -165,20 +211,42 @@ struct HomePage {
         Color bgc = 0xeee4da_rgb, fgc = 0x776e65_rgb;
         auto option = InputOption::Spacious();
         option.on_change = [this] {
-            int depth = -3;
+            // "250ms" asks for a time budget per move instead of a depth.
+            // Only complete input applies, so typing "200ms" doesn't search
+            // at depth 20 or 200 on the way.
+            const bool timed = search_depth.ends_with("ms");
+            const std::string number =
+                search_depth.substr(0, search_depth.size() - (timed ? 2 : 0));
+            const size_t sign = !timed && number.starts_with('-') ? 1 : 0;
+            if (number.size() == sign ||
+                number.find_first_not_of("0123456789", sign) !=
+                    std::string::npos) {
+                return;
+            }
+            int value;
             try {
-                depth = std::stoi(search_depth);
-                brd->solver.set_depth(depth);
+                value = std::stoi(number);
             } catch (const std::exception&) {
-                brd->solver.set_depth(-3);
+                return;  // out of range
             }
+            if (!timed && (value < core::solver::MIN_DEPTH ||
+                           value > core::solver::MAX_DEPTH)) {
+                return;
+            }
+            const int depth = timed ? core::solver::MIN_DEPTH : value;
+            const std::chrono::milliseconds budget{timed ? value : 0};
+            brd->ConfigureSolver([depth, budget](core::solver& solver) {
+                solver.set_depth(depth);
+                solver.set_time_budget(budget);
+            });
         };
         option.multiline = false;
         Component input = Input(&search_depth, "Depth", option) |
                           size(WIDTH, GREATER_THAN, 4);
         input |= CatchEvent([&](Event event) {
-            return event.is_character() && event.character()[0] != '-' &&
-                   !std::isdigit(event.character()[0]);
+            const char c = event.is_character() ? event.character()[0] : 0;
+            return event.is_character() && c != '-' && c != 'm' && c != 's' &&
+                   !std::isdigit(c);
         });
         return Container::Horizontal(
             {Text("Search Depth:") | vcenter,
@@ -186,6 +254,135 @@ struct HomePage {
                  vcenter}) /* | bgcolor(0xeee4da_rgb) | color(0x776e65_rgb)*/;
     }
 
+    // Optional panel with the statistics of the last automatic-play search.
+    ftxui::Component SearchStats() {
+        using namespace ftxui;
+        auto panel = Renderer([this] {
+            const auto& stats = brd->LastSearchStats();
+            auto row = [](std::string name, std::string value) {
+                return hbox({text(name), filler(), text(value)});
+            };
+            return vbox({
+                       row("Nodes: ", std::to_string(stats.nodes)),
+                       row("Cache hits: ",
+                           std::to_string(int(stats.cache_hit_rate() * 100 +
+                                              0.5)) +
+                               "%"),
+                       row("Cache evictions: ",
+                           std::to_string(stats.cache_evictions)),
+                       row("Depth: ", std::to_string(stats.depth)),
+                       row("Time: ",
+                           std::to_string(
+                               std::chrono::duration_cast<
+                                   std::chrono::microseconds>(stats.time)
+                                   .count()) +
+                               " us"),
+                   }) |
+                   borderRounded | bgcolor(0xeee4da_rgb) | color(0x776e65_rgb);
+        });
+        return Container::Vertical(
+            {Checkbox("Search statistics", &show_stats),
+             Maybe(panel, &show_stats)});
+    }
+
+    // Optional panel under the board with the solver's value of each move
+    // from the current position, refined as the search deepens.
+    ftxui::Component MoveHints() {
+        using namespace ftxui;
+        auto option = CheckboxOption::Simple();
+        option.on_change = [this] { brd->SetHints(show_hints); };
+        auto panel = Renderer([this] {
+            const core::solver::analysis& hint = brd->Hint();
+            if (hint.best_move == -1) {
+                // nothing is searched once the game is over, nor in a replay
+                const char* status =
+                    board.is_over()    ? "Game over: no legal moves"
+                    : brd->Replaying() ? "No hints in a replay"
+                                       : "Searching...";
+                return text(status) | borderRounded | bgcolor(0xeee4da_rgb) |
+                       color(0x776e65_rgb);
+            }
+            static const char* const names[4] = {"Left", "Down", "Right",
+                                                 "Up"};
+            Elements rows;
+            for (int dir : {core::direction::up, core::direction::left,
+                            core::direction::down, core::direction::right}) {
+                const bool legal = (hint.legal_moves >> dir) & 1;
+                Element row = hbox(
+                    {text(names[dir]), filler(),
+                     text(legal ? std::to_string(std::llround(hint.value[dir]))
+                                : "-")});
+                rows.push_back(dir == hint.best_move ? row | bold : row);
+            }
+            rows.push_back(separator());
+            rows.push_back(hbox({text("Depth: "), filler(),
+                                 text(std::to_string(hint.counters.depth))}));
+            rows.push_back(hbox({text("Nodes: "), filler(),
+                                 text(std::to_string(hint.counters.nodes))}));
+            return vbox(std::move(rows)) | borderRounded |
+                   bgcolor(0xeee4da_rgb) | color(0x776e65_rgb);
+        });
+        return Container::Vertical(
+            {Checkbox("Move hints", &show_hints, option),
+             Maybe(panel, &show_hints)});
+    }
+
+    // Loads a game of a record file into the board, with a slider over its
+    // moves; Reset goes back to playing.
+    ftxui::Component ReplayControls() {
+        using namespace ftxui;
+        auto option = InputOption::Default();
+        option.on_enter = [this] { LoadReplay(); };
+        option.multiline = false;
+        Component path = Input(&replay_path, "Record file", option) |
+                         size(WIDTH, GREATER_THAN, 12);
+        Component game =
+            Input(&replay_game, "0", option) | size(WIDTH, GREATER_THAN, 4);
+        // Filter out non-digit characters.
+        game |= CatchEvent([&](Event event) {
+            return event.is_character() && !std::isdigit(event.character()[0]);
+        });
+        Component slider =
+            Slider("", &brd->replay_move, 0, &brd->replay_moves, 1) |
+            CatchEvent([this](Event) {
+                ScreenInteractive::Active()->Post(
+                    [this] { brd->SeekReplay(brd->replay_move); });
+                return false;
+            });
+        Component position = Renderer([this] {
+            return text("Move " + std::to_string(brd->replay_move) + " / " +
+                        std::to_string(brd->replay_moves));
+        });
+        return Container::Vertical(
+            {Container::Horizontal(
+                 {Text("Replay: ") | vcenter, path | vcenter,
+                  Text(" game ") | vcenter, game | vcenter,
+                  Button("Load", [this] { LoadReplay(); },
+                         ButtonOption::Animated(0xeee4da_rgb, 0x776e65_rgb))}),
+             Renderer([this] { return text(replay_status); }),
+             Maybe(Container::Vertical(
+                       {Maybe(slider, [this] { return brd->replay_moves > 0; }),
+                        position}),
+                   [this] { return brd->Replaying(); })});
+    }
+
+    void LoadReplay() {
+        try {
+            const core::record_reader reader(replay_path);
+            const size_t game = std::stoul(replay_game);
+            if (game >= reader.size()) {
+                replay_status = "The file has " +
+                                std::to_string(reader.size()) + " games";
+                return;
+            }
+            brd->StartReplay(std::make_shared<core::game_replay>(reader[game]));
+            replay_status.clear();
+            brd->TakeFocus();
+        } catch (const std::exception& e) {
+            replay_status = e.what();
+        }
+    }
+
     ftxui::Component AnimationDurationAdjust() {
         using namespace ftxui;
         auto option = InputOption::Spacious();
@@ -257,12 +454,10 @@ struct HomePage {
             "Automatic Play",
             [this] {
                 if (!board.is_over()) {
-                    brd->automatic_move = !brd->automatic_move;
+                    brd->SetAutomaticMove(!brd->automatic_move);
                     brd->TakeFocus();
-                    ScreenInteractive::Active()->PostEvent(
-                        Event::Special("automatic_move"));
                 } else {
-                    brd->automatic_move = false;
+                    brd->SetAutomaticMove(false);
                 }
             },
             ButtonOption::Animated(0xeee4da_rgb, 0x776e65_rgb));
@@ -278,10 +473,19 @@ struct HomePage {
     std::string cell_size = "5";
     std::string search_depth = "-3";
     std::string animation_duration = "125";
+    std::string replay_path;
+    std::string replay_game = "0";
+    std::string replay_status;
     int duration_ms = 125;
     int best_score = 0;
     int score = 0;
     bool show_modal = false;
+    bool show_stats = false;
+    bool show_hints = false;
     BoardOption option;
+    // leaf evaluation for the solver, the built-in heuristic if null
+    std::shared_ptr<const core::evaluator> evaluator;
+    // where the games played are streamed, if anywhere
+    std::shared_ptr<core::record_writer> recorder;
 };
 };  // namespace tui
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "rng.hpp"
+
+namespace core {
+// Zobrist keys for boards of one size: a random word per cell and tile
+// exponent, XORed into the hash when the tile appears or leaves, so a board
+// can keep its hash up to date in O(1) per changed cell.
+class zobrist_table {
+   public:
+    static constexpr int EXPONENTS = 32;  // tiles up to 1 << 31
+
+    // Shared per size; built on first use and never freed.
+    static const zobrist_table& of_size(int size) {
+        static std::mutex mtx;
+        static std::vector<std::unique_ptr<zobrist_table>> tables;
+        std::lock_guard lock(mtx);
+        if (size >= int(tables.size())) {
+            tables.resize(size + 1);
+        }
+        if (!tables[size]) {
+            tables[size].reset(new zobrist_table(size));
+        }
+        return *tables[size];
+    }
+
+    // key of `exponent` at cell n; exponent 0 (empty) has key 0
+    uint64_t key(int n, int exponent) const {
+        return keys[n * EXPONENTS + exponent];
+    }
+
+   private:
+    std::unique_ptr<uint64_t[]> keys;
+
+    explicit zobrist_table(int size)
+        : keys(std::make_unique<uint64_t[]>(size * size * EXPONENTS)) {
+        // seeded with the size, so equal tiles on different sizes differ
+        uint64_t state = uint64_t(size) * 0x9e3779b97f4a7c15ULL;
+        for (int n = 0; n < size * size; ++n) {
+            for (int e = 1; e < EXPONENTS; ++e) {
+                keys[n * EXPONENTS + e] = splitmix64(state);
+            }
+        }
+    }
+};
+}  // namespace core
@@ -0,0 +1,215 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+
+#include "ntuple.hpp"
+#include "sim/batch.hpp"
+
+namespace {
+void usage(const char* prog) {
+    std::cerr
+        << "usage: " << prog << " [options]\n"
+        << "  --games N      number of games to play (default 100)\n"
+        << "  --depth D      search depth, <= 0 picks automatically (-3)\n"
+        << "  --budget MS    time per move in ms, deepening iteratively;\n"
+        << "                 overrides --depth (0 = off)\n"
+        << "  --min-prob P   evaluate spawns reached with probability < P\n"
+        << "                 as leaves (0 = off)\n"
+        << "  --spawn-cells N  expand at most N spawn cells per chance node\n"
+        << "                 (0 = all)\n"
+        << "  --weights FILE evaluate leaves with the n-tuple network in FILE\n"
+        << "                 (from 2048-train) instead of the heuristic\n"
+        << "  --store FILE   reuse and extend the search results kept in FILE\n"
+        << "                 by earlier runs with the same settings\n"
+        << "  --record FILE  append every game, move by move, to FILE\n"
+        << "  --size S       board size (4)\n"
+        << "  --seed X       batch seed; game i uses a seed derived from it\n"
+        << "  --threads T    worker threads, 0 = all cores (0)\n"
+        << "  --out FILE     write per-game CSV to FILE instead of stdout\n"
+        << "  --stats 1      add search statistics columns to the CSV\n";
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    sim::batch_option option;
+    std::string out_path, weights_path, store_path, record_path;
+    bool with_stats = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            usage(argv[0]);
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        const char* value = argv[++i];
+        try {
+            if (arg == "--games") {
+                option.games = std::stoi(value);
+            } else if (arg == "--depth") {
+                option.depth = std::stoi(value);
+            } else if (arg == "--budget") {
+                option.time_budget =
+                    std::chrono::milliseconds(std::stoi(value));
+            } else if (arg == "--min-prob") {
+                option.min_probability = std::stod(value);
+            } else if (arg == "--spawn-cells") {
+                option.max_spawn_cells = std::stoi(value);
+            } else if (arg == "--weights") {
+                weights_path = value;
+            } else if (arg == "--store") {
+                store_path = value;
+            } else if (arg == "--record") {
+                record_path = value;
+            } else if (arg == "--size") {
+                option.board_size = std::stoi(value);
+            } else if (arg == "--seed") {
+                option.seed = std::stoull(value);
+            } else if (arg == "--threads") {
+                option.threads = std::stoi(value);
+            } else if (arg == "--stats") {
+                with_stats = std::stoi(value) != 0;
+            } else if (arg == "--out") {
+                out_path = value;
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "invalid value for " << arg << ": " << value << "\n";
+            return 1;
+        }
+    }
+    if (option.board_size < 2 || option.games < 0 ||
+        option.time_budget.count() < 0 || option.min_probability < 0 ||
+        option.max_spawn_cells < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (!weights_path.empty()) {
+        try {
+            option.evaluator = core::ntuple_network::load(weights_path);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+    }
+    if (!store_path.empty()) {
+        core::solver configured;
+        sim::configure_solver(configured, option);
+        try {
+            option.store = std::make_shared<core::position_store>(
+                store_path, configured.settings_fingerprint());
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+    }
+    if (!record_path.empty()) {
+        try {
+            option.recorder =
+                std::make_shared<core::record_writer>(record_path);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    std::ofstream file;
+    if (!out_path.empty()) {
+        file.open(out_path);
+        if (!file) {
+            std::cerr << "cannot open " << out_path << "\n";
+            return 1;
+        }
+    }
+    std::ostream& out = out_path.empty() ? std::cout : file;
+    out << "game,seed,score,max_tile,moves,ms_per_move,max_move_ms";
+    if (with_stats) {
+        out << ",nodes,cache_hit_rate,cache_stores,cache_evictions,mean_depth";
+    }
+    out << "\n";
+
+    const auto summaries =
+        sim::run_batch(option, [&out, with_stats](const sim::game_summary& g) {
+            out << g.game << ',' << g.seed << ',' << g.score << ','
+                << g.max_tile << ',' << g.moves << ',' << g.ms_per_move()
+                << ','
+                << std::chrono::duration<double, std::milli>(g.max_move_time)
+                       .count();
+            if (with_stats) {
+                out << ',' << g.search.nodes << ','
+                    << g.search.cache_hit_rate() << ',' << g.search.cache_stores
+                    << ',' << g.search.cache_evictions << ','
+                    << g.mean_depth();
+            }
+            out << '\n';
+        });
+
+    if (option.store) {
+        const size_t recorded = option.store->pending_size();
+        try {
+            option.store->merge();
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+        std::cerr << "store: " << option.store->size() << " positions read, "
+                  << recorded << " merged\n";
+    }
+    if (summaries.empty()) {
+        return 0;
+    }
+    uint64_t total_score = 0;
+    long long total_moves = 0;
+    std::chrono::nanoseconds total_time{0};
+    core::solver::stats total_search;
+    long long total_depth = 0;
+    std::map<int, int> max_tiles;
+    for (auto& g : summaries) {
+        total_score += g.score;
+        total_moves += g.moves;
+        total_time += g.search_time;
+        total_search.merge(g.search);
+        total_depth += g.depth_total;
+        ++max_tiles[g.max_tile];
+    }
+    std::cerr << "games: " << summaries.size()
+              << "  mean score: " << double(total_score) / summaries.size()
+              << "  mean moves: " << double(total_moves) / summaries.size()
+              << "  ms/move: "
+              << (total_moves == 0
+                      ? 0.0
+                      : std::chrono::duration<double, std::milli>(total_time)
+                                .count() /
+                            total_moves)
+              << "\n";
+    if (with_stats && total_moves > 0) {
+        const double seconds =
+            std::chrono::duration<double>(total_time).count();
+        std::cerr << "  nodes/s: "
+                  << (seconds > 0 ? total_search.nodes / seconds : 0.0)
+                  << "  cache hit rate: " << total_search.cache_hit_rate()
+                  << "  evictions/store: "
+                  << (total_search.cache_stores == 0
+                          ? 0.0
+                          : double(total_search.cache_evictions) /
+                                total_search.cache_stores)
+                  << "  mean depth: " << double(total_depth) / total_moves;
+        if (option.store) {
+            std::cerr << "  store hits: " << total_search.store_hits;
+        }
+        std::cerr << "\n";
+    }
+    for (auto& [tile, count] : max_tiles) {
+        std::cerr << "  max tile " << tile << ": " << count << " ("
+                  << 100.0 * count / summaries.size() << "%)\n";
+    }
+    return 0;
+}
@@ -1,9 +1,28 @@
 ﻿#include <ftxui/component/screen_interactive.hpp>
+#include <iostream>
+#include <memory>
+#include <string>
 
+#include "game_record.hpp"
+#include "ntuple.hpp"
 #include "tui/homepage.hpp"
-int main() {
+int main(int argc, char** argv) {
     using namespace ftxui;
     tui::HomePage page;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            if (arg == "--record" && i + 1 < argc) {  // games, move by move
+                page.recorder =
+                    std::make_shared<core::record_writer>(argv[++i]);
+            } else {  // n-tuple weights written by 2048-train
+                page.evaluator = core::ntuple_network::load(arg);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
     page.start();
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,1092 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bitboard.hpp"
+#include "board_2048.hpp"
+#include "board_t.hpp"
+#include "game_history.hpp"
+#include "game_record.hpp"
+#include "move_tables.hpp"
+#include "ntuple.hpp"
+#include "position_store.hpp"
+#include "row_kernel.hpp"
+#include "solver.hpp"
+#include "symmetry.hpp"
+#include "train/td.hpp"
+
+// Behavioural checks of the game logic; exits non-zero on any failure.
+namespace {
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    if (!ok) {
+        ++failures;
+        if (failures <= 20) {
+            std::cerr << "FAILED: " << what << "\n";
+        }
+    }
+}
+
+// Random tiles with few distinct values, so lines often merge; exponents
+// up to `max_exponent`, a fifth of the cells empty.
+core::board_2048 random_board(int size, int max_exponent,
+                              std::mt19937_64& engine) {
+    core::board_2048 board(size);
+    for (int x = 0; x < size; ++x) {
+        for (int y = 0; y < size; ++y) {
+            const int exponent = int(engine() % uint64_t(max_exponent + 1));
+            board.set_tile(x, y, exponent == 0 || engine() % 5 == 0
+                                     ? 0
+                                     : 1 << exponent);
+        }
+    }
+    return board;
+}
+
+std::string describe(const core::board_2048& board, int dir) {
+    std::string text = std::to_string(board.size()) + "x" +
+                       std::to_string(board.size()) + " dir " +
+                       std::to_string(dir) + ":";
+    for (int x = 0; x < board.size(); ++x) {
+        for (int y = 0; y < board.size(); ++y) {
+            text += " " + std::to_string(board.get_tile(x, y));
+        }
+    }
+    return text;
+}
+
+// Cell k of line i for a move in `dir`, counted from the edge the tiles
+// move towards.
+std::pair<int, int> line_cell(int size, int dir, int i, int k) {
+    switch (dir) {
+        case core::direction::left:
+            return {i, k};
+        case core::direction::down:
+            return {size - 1 - k, i};
+        case core::direction::right:
+            return {i, size - 1 - k};
+        default:
+            return {k, i};
+    }
+}
+
+// The reference move, written from the rules rather than from any of the
+// boards: the tiles of each line slide to the edge, and each pair of equal
+// neighbours merges once, the pair nearest the edge first. Returns the
+// score gained.
+uint64_t reference_move(core::board_2048& board, int dir) {
+    const int size = board.size();
+    uint64_t gain = 0;
+    for (int i = 0; i < size; ++i) {
+        std::vector<int> line;
+        for (int k = 0; k < size; ++k) {
+            const auto [x, y] = line_cell(size, dir, i, k);
+            if (board.get_tile(x, y) != 0) {
+                line.push_back(board.get_tile(x, y));
+            }
+        }
+        std::vector<int> merged;
+        for (size_t k = 0; k < line.size(); ++k) {
+            if (k + 1 < line.size() && line[k] == line[k + 1]) {
+                merged.push_back(2 * line[k]);
+                gain += uint64_t(2 * line[k]);
+                ++k;
+            } else {
+                merged.push_back(line[k]);
+            }
+        }
+        for (int k = 0; k < size; ++k) {
+            const auto [x, y] = line_cell(size, dir, i, k);
+            board.set_tile(x, y, size_t(k) < merged.size() ? merged[k] : 0);
+        }
+    }
+    return gain;
+}
+
+template <typename Board>
+bool same_tiles(const Board& board, const core::board_2048& expected) {
+    for (int x = 0; x < expected.size(); ++x) {
+        for (int y = 0; y < expected.size(); ++y) {
+            if (board.get_tile(x, y) != expected.get_tile(x, y)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// `Board` moved from `board` must end where the reference does, with the
+// same score, and its legal moves be exactly those that change the board.
+template <typename Board>
+void check_against_reference(const core::board_2048& board,
+                             const std::string& type) {
+    const Board packed(board);
+    int expected_mask = 0;
+    for (int dir = 0; dir < 4; ++dir) {
+        core::board_2048 expected = board;
+        const uint64_t gain = reference_move(expected, dir);
+        Board moved = packed;
+        moved.move(dir);
+        check(same_tiles(moved, expected) &&
+                  moved.get_score() == board.get_score() + gain,
+              type + " move " + describe(board, dir));
+        check(packed.valid_move(dir) == !(expected == board),
+              type + " valid_move " + describe(board, dir));
+        expected_mask |= expected == board ? 0 : 1 << dir;
+    }
+    check(packed.legal_moves_mask() == expected_mask &&
+              packed.is_over() == (expected_mask == 0),
+          type + " legal_moves_mask " + describe(board, -1));
+}
+
+struct fixed_move {
+    int dir;
+    std::array<int, 16> before;
+    std::array<int, 16> after;
+    uint64_t score;
+};
+
+// Hand-written 4x4 moves. Each row (or column) is one case: [2,2,2,2]
+// makes two 4s, of three equal tiles the two nearest the edge merge, a new
+// tile doesn't merge again, and every merge scores the tile it makes.
+const fixed_move fixed_moves[] = {
+    {core::direction::left,
+     {2, 2, 2, 2, 2, 2, 2, 0, 4, 4, 8, 8, 2, 0, 2, 4},
+     {4, 4, 0, 0, 4, 2, 0, 0, 8, 16, 0, 0, 4, 4, 0, 0},
+     40},
+    {core::direction::right,
+     {2, 2, 2, 2, 2, 2, 2, 0, 4, 4, 8, 8, 2, 0, 2, 4},
+     {0, 0, 4, 4, 0, 0, 2, 4, 0, 0, 8, 16, 0, 0, 4, 4},
+     40},
+    {core::direction::up,
+     {2, 2, 4, 2, 2, 2, 4, 0, 2, 2, 8, 2, 2, 0, 8, 4},
+     {4, 4, 8, 4, 4, 2, 16, 4, 0, 0, 0, 0, 0, 0, 0, 0},
+     40},
+    {core::direction::down,
+     {2, 2, 4, 2, 2, 2, 4, 0, 2, 2, 8, 2, 2, 0, 8, 4},
+     {0, 0, 0, 0, 0, 0, 0, 0, 4, 2, 8, 4, 4, 4, 16, 4},
+     40},
+    {core::direction::left,
+     {8, 4, 4, 0, 0, 0, 0, 2, 16384, 16384, 0, 0, 2, 4, 8, 16},
+     {8, 8, 0, 0, 2, 0, 0, 0, 32768, 0, 0, 0, 2, 4, 8, 16},
+     32776},
+    {core::direction::left,
+     {32768, 32768, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+     {65536, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+     65540},
+    {core::direction::up,
+     {2, 4, 8, 16, 4, 8, 16, 2, 2, 4, 8, 16, 4, 8, 16, 2},
+     {2, 4, 8, 16, 4, 8, 16, 2, 2, 4, 8, 16, 4, 8, 16, 2},
+     0},
+};
+
+core::board_2048 make_board(const std::array<int, 16>& tiles) {
+    core::board_2048 board(4);
+    for (int i = 0; i < 16; ++i) {
+        board.set_tile(i / 4, i % 4, tiles[i]);
+    }
+    return board;
+}
+
+void test_fixed_moves() {
+    for (const fixed_move& c : fixed_moves) {
+        const core::board_2048 before = make_board(c.before);
+        const core::board_2048 after = make_board(c.after);
+        const std::string name = describe(before, c.dir);
+
+        core::board_2048 expected = before;
+        check(reference_move(expected, c.dir) == c.score && expected == after,
+              "reference move " + name);
+        core::board_2048 moved = before;
+        moved.move(c.dir);
+        check(moved == after && moved.get_score() == c.score,
+              "board_2048 fixed move " + name);
+        check(before.valid_move(c.dir) == !(after == before),
+              "board_2048 fixed valid_move " + name);
+        core::board_t<4> sized(before);
+        sized.move(c.dir);
+        check(same_tiles(sized, after) && sized.get_score() == c.score,
+              "board_t<4> fixed move " + name);
+
+        // the bitboard's nibbles stop at 32768
+        check(core::bitboard::fits(before) ==
+                  (*std::max_element(c.before.begin(), c.before.end()) <
+                   32768),
+              "bitboard fits " + name);
+        if (core::bitboard::fits(before)) {
+            core::bitboard packed(before);
+            packed.move(c.dir);
+            check(same_tiles(packed, after) && packed.get_score() == c.score,
+                  "bitboard fixed move " + name);
+        }
+    }
+}
+
+// A full board without equal neighbours is lost; one pair in a column, or
+// an empty cell, leaves only the moves that close it.
+void test_fixed_legal_moves() {
+    core::board_2048 board =
+        make_board({2, 4, 8, 16, 4, 8, 16, 2, 2, 4, 8, 16, 4, 8, 16, 2});
+    check(board.legal_moves_mask() == 0 && board.is_over() &&
+              core::bitboard(board).legal_moves_mask() == 0 &&
+              core::bitboard(board).is_over(),
+          "legal moves of a lost board");
+
+    board.set_tile(1, 0, 2);  // column 0 is 2 2 2 4
+    int expected = (1 << core::direction::down) | (1 << core::direction::up);
+    check(board.legal_moves_mask() == expected && !board.is_over() &&
+              core::bitboard(board).legal_moves_mask() == expected,
+          "legal moves of a column pair");
+
+    board.set_tile(1, 0, 4);
+    board.set_tile(0, 3, 0);  // only right and up fill the hole
+    expected = (1 << core::direction::right) | (1 << core::direction::up);
+    check(board.legal_moves_mask() == expected &&
+              core::bitboard(board).legal_moves_mask() == expected,
+          "legal moves of an empty cell");
+}
+
+// Every row of the 4x4 move tables, against the reference on a board
+// holding only that row. Two 32768 tiles, exponent 15, stay apart.
+void test_row_tables() {
+    const core::row_table& table = core::row_tables();
+    for (int row = 0; row < core::row_table::ROWS; ++row) {
+        std::array<int, 16> tiles{};
+        bool mergeable = true;
+        for (int y = 0; y < 4; ++y) {
+            const int exponent = (row >> (4 * y)) & 0xF;
+            tiles[y] = exponent ? 1 << exponent : 0;
+            mergeable = mergeable && exponent < 15;
+        }
+        if (!mergeable) {
+            continue;
+        }
+        const core::board_2048 board = make_board(tiles);
+        for (int dir : {core::direction::left, core::direction::right}) {
+            core::board_2048 expected = board;
+            const uint64_t gain = reference_move(expected, dir);
+            const bool left = dir == core::direction::left;
+            const int moved = left ? table.left[row] : table.right[row];
+            // the right move gains what the left move of the reversed row does
+            const uint16_t scored =
+                left ? uint16_t(row) : core::row_table::reverse_row(row);
+            bool same = table.score[scored] == gain;
+            for (int y = 0; y < 4; ++y) {
+                const int exponent = (moved >> (4 * y)) & 0xF;
+                same = same && expected.get_tile(0, y) ==
+                                   (exponent ? 1 << exponent : 0);
+            }
+            check(same, "row table " + describe(board, dir));
+        }
+    }
+    check(table.left[0x00FF] == 0x00FF && table.right[0xFF00] == 0xFF00 &&
+              table.score[0x00FF] == 0,
+          "row table merged two 32768 tiles");
+}
+
+// board_2048 also keeps its incremental hash through a move: it must match
+// that of the reference board, whose tiles were set one by one.
+void test_board_2048_moves(std::mt19937_64& engine) {
+    for (int size = 2; size <= 20; ++size) {
+        for (int i = 0; i < 1000; ++i) {
+            const core::board_2048 board =
+                random_board(size, size == 4 ? 14 : 17, engine);
+            check_against_reference<core::board_2048>(board, "board_2048");
+            for (int dir = 0; dir < 4; ++dir) {
+                core::board_2048 expected = board;
+                reference_move(expected, dir);
+                core::board_2048 moved = board;
+                moved.move(dir);
+                check(moved.hash() == expected.hash(),
+                      "board_2048 hash " + describe(board, dir));
+            }
+        }
+    }
+}
+
+// move with a tile list must move as move(dir) does, and the list account
+// for every tile: each moves once, to a cell holding it alone or merged
+// with exactly one other, and `merged` says which.
+void check_tile_moves(const core::board_2048& board) {
+    const int size = board.size();
+    for (int dir = 0; dir < 4; ++dir) {
+        core::board_2048 expected = board;
+        const uint64_t gain = reference_move(expected, dir);
+        core::board_2048 moved = board;
+        std::vector<core::tile_move> moves;
+        moved.move(dir, moves);
+        bool ok = same_tiles(moved, expected) &&
+                  moved.get_score() == board.get_score() + gain &&
+                  moves.size() == size_t(board.count_tiles());
+
+        std::vector<int> landed(size_t(size * size), 0);
+        std::vector<int> arrivals(size_t(size * size), 0);
+        std::vector<int> departures(size_t(size * size), 0);
+        for (const core::tile_move& m : moves) {
+            const int tile = board.get_tile(m.from / size, m.from % size);
+            ok = ok && tile != 0 && ++departures[size_t(m.from)] == 1 &&
+                 m.to >= 0 && m.to < size * size;
+            if (ok) {
+                landed[size_t(m.to)] += tile;
+                ++arrivals[size_t(m.to)];
+            }
+        }
+        for (const core::tile_move& m : moves) {
+            ok = ok && m.merged == (arrivals[size_t(m.to)] == 2);
+        }
+        for (int cell = 0; ok && cell < size * size; ++cell) {
+            ok = arrivals[size_t(cell)] <= 2 &&
+                 landed[size_t(cell)] == moved.get_tile(cell / size,
+                                                        cell % size);
+        }
+        check(ok, "tile moves " + describe(board, dir));
+    }
+}
+
+void test_tile_moves(std::mt19937_64& engine) {
+    // row 0 is 2 2 2 0: the two nearest the right edge merge there
+    core::board_2048 board = make_board({2, 2, 2, 0});
+    std::vector<core::tile_move> moves;
+    board.move(core::direction::right, moves);
+    check(moves.size() == 3 && moves[0].from == 2 && moves[0].to == 3 &&
+              moves[0].merged && moves[1].from == 1 && moves[1].to == 3 &&
+              moves[1].merged && moves[2].from == 0 && moves[2].to == 2 &&
+              !moves[2].merged,
+          "tile moves of 2 2 2 0");
+
+    for (int size = 2; size <= 12; ++size) {
+        for (int i = 0; i < 500; ++i) {
+            check_tile_moves(random_board(size, 12, engine));
+        }
+    }
+}
+
+template <int N>
+void test_board_t(std::mt19937_64& engine) {
+    for (int i = 0; i < 4000; ++i) {
+        check_against_reference<core::board_t<N>>(
+            random_board(N, 12, engine),
+            "board_t<" + std::to_string(N) + ">");
+    }
+}
+
+void test_bitboard(std::mt19937_64& engine) {
+    for (int i = 0; i < 20000; ++i) {
+        const core::board_2048 board = random_board(4, 14, engine);
+        check(core::bitboard::fits(board),
+              "bitboard fits " + describe(board, -1));
+        check_against_reference<core::bitboard>(board, "bitboard");
+    }
+}
+
+// Moving a board and taking its image under a symmetry must commute once
+// the move is mapped along, for every symmetry and direction.
+template <typename Board>
+void check_symmetries(const core::board_2048& board, const std::string& type) {
+    const Board original(board);
+    for (int sym = 0; sym < core::symmetry::COUNT; ++sym) {
+        const Board image = core::symmetry::apply(original, sym);
+        for (int dir = 0; dir < 4; ++dir) {
+            const int mapped = core::symmetry::map_move(sym, dir);
+            Board moved = original;
+            moved.move(dir);
+            Board moved_image = image;
+            moved_image.move(mapped);
+            check(core::symmetry::apply(moved, sym) == moved_image &&
+                      moved_image.get_score() == moved.get_score(),
+                  type + " move under symmetry " + std::to_string(sym) +
+                      ", " + describe(board, dir));
+        }
+    }
+}
+
+// The symmetries themselves, and the canonical forms the solver keys its
+// cache with: the bitboard's least packed image and the generic least image
+// are each the same for all eight images of a board.
+void test_symmetry(std::mt19937_64& engine) {
+    for (int sym = 0; sym < core::symmetry::COUNT; ++sym) {
+        int images = 0;
+        for (int dir = 0; dir < 4; ++dir) {
+            const int mapped = core::symmetry::map_move(sym, dir);
+            check(core::symmetry::unmap_move(sym, mapped) == dir,
+                  "unmap_move of map_move, symmetry " + std::to_string(sym));
+            images |= 1 << mapped;
+        }
+        check(images == 0xF, "map_move permutes the directions");
+    }
+
+    for (int i = 0; i < 2000; ++i) {
+        const core::board_2048 board = random_board(4, 14, engine);
+        check_symmetries<core::bitboard>(board, "bitboard");
+        check_symmetries<core::board_t<4>>(board, "board_t<4>");
+        check_symmetries<core::board_2048>(board, "board_2048");
+
+        const core::bitboard packed(board);
+        const auto [bits, sym] = core::bitboard::canonical(packed.raw());
+        const int generic = core::symmetry::canonical(board, 8);
+        check(core::symmetry::apply(packed, sym).raw() == bits,
+              "bitboard canonical image " + describe(board, -1));
+        for (int s = 0; s < core::symmetry::COUNT; ++s) {
+            const core::bitboard image = core::symmetry::apply(packed, s);
+            check(bits <= image.raw() &&
+                      core::bitboard::canonical(image.raw()).first == bits,
+                  "bitboard canonical of image " + std::to_string(s) + ", " +
+                      describe(board, -1));
+            const core::board_2048 board_image =
+                core::symmetry::apply(board, s);
+            check(core::symmetry::apply(
+                      board_image,
+                      core::symmetry::canonical(board_image, 8)) ==
+                      core::symmetry::apply(board, generic),
+                  "canonical of image " + std::to_string(s) + ", " +
+                      describe(board, -1));
+            check(board.hash(s) == board_image.hash(),
+                  "hash of image " + std::to_string(s) + ", " +
+                      describe(board, -1));
+        }
+    }
+    for (int size : {2, 3, 5, 8}) {
+        for (int i = 0; i < 500; ++i) {
+            check_symmetries<core::board_2048>(random_board(size, 12, engine),
+                                               "board_2048");
+        }
+    }
+    for (int i = 0; i < 500; ++i) {
+        check_symmetries<core::board_t<5>>(random_board(5, 12, engine),
+                                           "board_t<5>");
+    }
+}
+
+// The SSSE3 row kernel, where built, against hand-written rows and its
+// scalar fallback.
+void test_row_kernel(std::mt19937_64& engine) {
+    struct fixed_row {
+        int width;
+        core::row_kernel::row before, after;
+        uint64_t gain;
+    };
+    const fixed_row fixed_rows[] = {
+        {4, {1, 1, 1, 1}, {2, 2}, 8},
+        {5, {1, 1, 1, 0, 2}, {2, 1, 2}, 4},
+        {6, {3, 0, 3, 3, 2, 2}, {4, 3, 3}, 24},
+        {16, {15, 15, 16}, {16, 16}, 65536},
+        {3, {0, 0, 0}, {}, 0},
+    };
+    for (const fixed_row& c : fixed_rows) {
+        core::row_kernel::row cells = c.before;
+        check(core::row_kernel::slide_and_merge(cells, c.width) == c.gain &&
+                  cells == c.after,
+              "row kernel, fixed row of " + std::to_string(c.width));
+    }
+
+    for (int i = 0; i < 100000; ++i) {
+        const int width = 1 + int(engine() % core::row_kernel::MAX_WIDTH);
+        core::row_kernel::row cells{};
+        for (int j = 0; j < width; ++j) {
+            const int e = int(engine() % 6);
+            cells[j] = uint8_t(e == 0 ? 0 : e + int(engine() % 3));
+        }
+        core::row_kernel::row scalar = cells;
+        const uint64_t expected_gain =
+            core::row_kernel::slide_and_merge_scalar(scalar, width);
+        core::row_kernel::row fast = cells;
+        check(core::row_kernel::slide_and_merge(fast, width) ==
+                      expected_gain &&
+                  fast == scalar,
+              "row kernel, width " + std::to_string(width));
+
+        uint64_t word = 0;
+        for (int j = 0; j < 8 && j < width; ++j) {
+            word |= uint64_t(cells[j]) << (8 * j);
+        }
+        uint64_t scalar_word = word;
+        const uint64_t word_gain =
+            core::row_kernel::slide_and_merge_scalar(scalar_word);
+        check(core::row_kernel::slide_and_merge(word) == word_gain &&
+                  word == scalar_word,
+              "row kernel, packed word");
+    }
+}
+
+// Two 32768 tiles merge into 65536 in the game, which the packed 4-bit
+// boards can't hold: such a board must not be searched as a bitboard.
+void test_32768() {
+    core::board_2048 board(4, 1);
+    for (int x = 0; x < 4; ++x) {
+        for (int y = 0; y < 4; ++y) {
+            board.set_tile(x, y, 2 << ((x * 4 + y) % 11));
+        }
+    }
+    board.set_tile(0, 0, 32768);
+    board.set_tile(0, 1, 32768);
+    check(!core::bitboard::fits(board), "32768 board fits a bitboard");
+    check_against_reference<core::board_2048>(board, "board_2048 32768");
+    check_against_reference<core::board_t<4>>(board, "board_t<4> 32768");
+
+    // no other tiles can merge, so only that merge keeps the game going
+    check(board.legal_moves_mask() == ((1 << core::direction::left) |
+                                       (1 << core::direction::right)),
+          "32768 board legal moves");
+    core::solver solver(2);
+    const int dir = solver.get_best_move(board);
+    check(dir == core::direction::left || dir == core::direction::right,
+          "solver move on the 32768 board");
+}
+
+// The root-parallel search against the serial one over seeded games. With
+// REQUIRE_DETERMINISTIC both pick the same move everywhere. Without it the
+// cache also keeps values of paths with fours and answers from deeper ones,
+// so which thread stored a position first can shift a value slightly: the
+// picks may then differ only where the serial search values both moves
+// within a hundredth.
+void test_parallel_search() {
+    struct game {
+        int size, depth, moves;
+    };
+    // few deep or 5x5 moves, which are slow unoptimised
+    const game games[] = {{4, 2, 300}, {4, 3, 8}, {5, 2, 10}};
+    for (const game& g : games) {
+        core::solver serial(g.depth);
+        core::solver parallel(g.depth);
+        parallel.set_threads(4);
+        core::board_2048 board(g.size, 4096 + uint64_t(g.size));
+        for (int i = 0; i < g.moves && !board.is_over(); ++i) {
+            const int dir = serial.get_best_move(board);
+            const int parallel_dir = parallel.get_best_move(board);
+            bool same = parallel_dir == dir;
+#ifndef REQUIRE_DETERMINISTIC
+            if (!same) {
+                const core::solver::analysis values = serial.analyze(board);
+                same = ((values.legal_moves >> parallel_dir) & 1) &&
+                       values.value[parallel_dir] >= 0.99 * values.value[dir];
+            }
+#endif
+            check(same, "parallel search move at depth " +
+                            std::to_string(g.depth) + ", " +
+                            describe(board, dir));
+            board.move(dir);
+            board.add_random_tile();
+        }
+    }
+}
+
+// A game played with random legal moves from `board`, recorded as played,
+// with the board after each move.
+core::game_record play_recorded(core::board_2048& board, int moves,
+                                std::mt19937_64& engine,
+                                std::vector<core::board_2048>& positions) {
+    core::game_record record(board, 7);
+    positions.assign(1, board);
+    for (int i = 0; i < moves && !board.is_over(); ++i) {
+        int dir = int(engine() % 4);
+        while (!board.valid_move(dir)) {
+            dir = (dir + 1) % 4;
+        }
+        board.move(dir);
+        const int cell = board.add_random_tile();
+        record.add(dir, cell,
+                   board.get_tile(cell / board.size(), cell % board.size()));
+        positions.push_back(board);
+    }
+    record.finish(board.get_score());
+    return record;
+}
+
+std::string temp_path(const std::string& name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+void write_file(const std::string& path, const std::vector<uint8_t>& bytes) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(bytes.data()),
+              std::streamsize(bytes.size()));
+}
+
+std::vector<uint8_t> read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), {});
+}
+
+// Games written whole and streamed read back move for move, also when
+// recording started mid-game with a score.
+void test_record_round_trip(std::mt19937_64& engine) {
+    const std::string path = temp_path("2048-test-records.bin");
+    std::filesystem::remove(path);
+    std::vector<std::vector<core::board_2048>> games;
+    {
+        core::record_writer writer(path);
+        for (int size : {3, 4, 6, 12}) {
+            core::board_2048 board(size, engine());
+            std::vector<core::board_2048> positions;
+            writer.write(play_recorded(board, 300, engine, positions));
+            games.push_back(positions);
+
+            // continue the same game as a new record, streamed
+            core::game_record resumed =
+                play_recorded(board, 200, engine, positions);
+            core::board_2048 start = positions.front();
+            writer.begin(core::game_record(start, 7));
+            core::game_view view(resumed.info(), resumed.bytes().data(),
+                                 resumed.bytes().data() +
+                                     resumed.bytes().size());
+            core::game_view::cursor cursor = view.moves_cursor();
+            core::recorded_move move;
+            while (cursor.next(move)) {
+                writer.add(move.dir, move.cell, move.tile);
+            }
+            writer.end(board.get_score());
+            games.push_back(positions);
+        }
+    }
+    const core::record_reader reader(path);
+    check(reader.size() == games.size(), "record game count");
+    for (size_t g = 0; g < reader.size() && g < games.size(); ++g) {
+        const core::game_view view = reader[g];
+        const std::vector<core::board_2048>& positions = games[g];
+        check(view.moves() + 1 == int(positions.size()),
+              "record moves of game " + std::to_string(g));
+        check(view.info().score == positions.back().get_score(),
+              "record score of game " + std::to_string(g));
+        core::game_replay replay(view, 16);
+        for (int i : {0, 1, 15, 16, 17, replay.size(), replay.size() / 2}) {
+            if (i > replay.size()) {
+                continue;
+            }
+            replay.seek(i);
+            const core::board_2048& expected = positions[size_t(i)];
+            const core::board_2048 at = view.board_at(i);
+            check(same_tiles(replay.board(), expected) &&
+                      replay.board().get_score() == expected.get_score() &&
+                      same_tiles(at, expected) &&
+                      at.get_score() == expected.get_score(),
+                  "record position " + std::to_string(i) + " of game " +
+                      std::to_string(g));
+        }
+    }
+    std::filesystem::remove(path);
+}
+
+// Truncated or corrupted files must not be read past their end or played
+// off the board: the reader drops a torn game, a replay of bad moves
+// throws, and a header's board size is bounded.
+void test_record_corruption(std::mt19937_64& engine) {
+    const std::string path = temp_path("2048-test-corrupt.bin");
+    std::filesystem::remove(path);
+    core::board_2048 board(4, engine());
+    std::vector<core::board_2048> positions;
+    const core::game_record record =
+        play_recorded(board, 100, engine, positions);
+    {
+        core::record_writer writer(path);
+        writer.write(record);
+        writer.write(record);
+    }
+    const std::vector<uint8_t> file = read_file(path);
+    const size_t first_game =
+        sizeof(core::game_record::MAGIC) + sizeof(core::game_record::header);
+
+    // a torn second game is dropped, the first stays whole
+    std::vector<uint8_t> torn(file.begin(), file.end() - 5);
+    write_file(path, torn);
+    {
+        const core::record_reader reader(path);
+        check(reader.size() == 1 &&
+                  uint32_t(reader[0].moves()) == record.info().moves,
+              "torn record");
+    }
+    // the writer cuts the torn game off and appends after the first
+    {
+        core::record_writer writer(path);
+        writer.write(record);
+    }
+    check(core::record_reader(path).size() == 2, "torn record repaired");
+
+    // a move whose cell is off the board
+    std::vector<uint8_t> bad = file;
+    const size_t moves_at =
+        first_game + 2 * size_t(record.info().start_tiles);  // 1-byte cells
+    bad[moves_at + 3] = 0x7F;  // cell 15 with a 4: fine on 4x4
+    bad[moves_at + 4] = 0xFF;  // two-byte varint: cell 31 or more
+    bad[moves_at + 5] = 0x01;
+    write_file(path, bad);
+    {
+        const core::record_reader reader(path);
+        bool thrown = false;
+        try {
+            core::game_replay replay(reader[0]);
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        check(thrown, "replay of a move off the board");
+        core::game_view::cursor cursor = reader[0].moves_cursor();
+        core::recorded_move move;
+        int read = 0;
+        while (cursor.next(move)) {
+            check(move.cell < 16, "cursor returned a cell off the board");
+            ++read;
+        }
+        check(cursor.corrupt() && read == 4, "cursor stops at the bad move");
+        reader[0].board_at(record.info().moves);  // stops there too
+    }
+
+    // a header claiming a huge board ends the list instead of allocating
+    bad = file;
+    core::game_record::header info;
+    std::memcpy(&info, bad.data() + sizeof(core::game_record::MAGIC),
+                sizeof(info));
+    info.board_size = 65535;
+    std::memcpy(bad.data() + sizeof(core::game_record::MAGIC), &info,
+                sizeof(info));
+    write_file(path, bad);
+    check(core::record_reader(path).size() == 0, "record of a 65535 board");
+
+    // random byte flips: whatever reads must stay on the board
+    for (int i = 0; i < 2000; ++i) {
+        bad = file;
+        for (int flips = 0; flips < 3; ++flips) {
+            bad[first_game + engine() % (bad.size() - first_game)] ^=
+                uint8_t(1 << (engine() % 8));
+        }
+        write_file(path, bad);
+        const core::record_reader reader(path);
+        for (size_t g = 0; g < reader.size(); ++g) {
+            reader[g].board_at(reader[g].moves());
+            try {
+                core::game_replay replay(reader[g]);
+                replay.seek(replay.size());
+            } catch (const std::runtime_error&) {
+            }
+        }
+    }
+    std::filesystem::remove(path);
+}
+
+// Runs of results merged into a store file and read back: each key keeps
+// its deepest value across pending results, runs and the compaction at
+// MAX_RUNS; a run torn by a crash is ignored, then compacted away by the
+// next merge; values of other search settings are refused.
+void test_position_store(std::mt19937_64& engine) {
+    constexpr uint64_t FINGERPRINT = 0x2048;
+    const std::string path = temp_path("2048-test-positions.bin");
+    const auto remove_files = [&] {
+        for (const char* suffix : {"", ".lock", ".tmp"}) {
+            std::filesystem::remove(path + suffix);
+        }
+    };
+    // a result as the solver packs it, the depth in the low 4 bits
+    const auto value_at = [&](int depth) {
+        return (engine() & ~uint64_t(0xF)) | uint64_t(depth);
+    };
+    std::vector<std::pair<uint64_t, uint64_t>> expected;
+    const auto check_all = [&](const std::string& what) {
+        const core::position_store store(path, FINGERPRINT);
+        bool ok = true;
+        for (const auto& [key, value] : expected) {
+            uint64_t found = 0;
+            ok = ok && store.find(key, found) && found == value;
+        }
+        check(ok, "position store " + what);
+        return store.size();
+    };
+    remove_files();
+
+    {
+        core::position_store store(path, FINGERPRINT);
+        check(store.size() == 0, "new position store is empty");
+        for (int i = 0; i < 1000; ++i) {
+            expected.emplace_back(engine(), value_at(1 + int(i % 10)));
+            store.record(expected.back().first, expected.back().second);
+        }
+        store.merge();
+        check(store.pending_size() == 0, "position store pending after merge");
+    }
+    check(check_all("round trip") == expected.size(),
+          "position store round trip size");
+
+    // half the keys deeper in a second run, after a shallower and before
+    // another shallower pending value; the rest only shallower
+    {
+        core::position_store store(path, FINGERPRINT);
+        for (size_t i = 0; i < expected.size(); ++i) {
+            auto& [key, value] = expected[i];
+            const int depth = int(value & 0xF);
+            if (i % 2 == 0) {
+                store.record(key, value_at(0));
+                const uint64_t deeper = value_at(depth + 1);
+                store.record(key, deeper);
+                store.record(key, value_at(depth));
+                value = deeper;
+            } else {
+                store.record(key, value_at(depth - 1));
+            }
+        }
+        store.merge();
+    }
+    check(check_all("keeps the deepest") == 2 * expected.size(),
+          "position store appends a run");
+
+    // merges up to MAX_RUNS runs fold all of them into one
+    for (int run = 2; run < core::position_store::MAX_RUNS; ++run) {
+        core::position_store store(path, FINGERPRINT);
+        expected.emplace_back(engine(), value_at(3));
+        store.record(expected.back().first, expected.back().second);
+        store.merge();
+    }
+    check(check_all("compacted") == expected.size() &&
+              std::filesystem::file_size(path) == 32 + 16 * expected.size(),
+          "position store compacts at MAX_RUNS");
+
+    // a merge cut short in its last run
+    std::vector<uint64_t> torn;
+    {
+        core::position_store store(path, FINGERPRINT);
+        for (int i = 0; i < 10; ++i) {
+            torn.push_back(engine());
+            store.record(torn.back(), value_at(5));
+        }
+        store.merge();
+    }
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 8);
+    check(check_all("torn run") == expected.size(),
+          "position store drops a torn run");
+    {
+        core::position_store store(path, FINGERPRINT);
+        expected.emplace_back(engine(), value_at(4));
+        store.record(expected.back().first, expected.back().second);
+        store.merge();
+    }
+    check(check_all("after a torn run") == expected.size() &&
+              std::filesystem::file_size(path) == 32 + 16 * expected.size(),
+          "position store compacts a torn run");
+    {
+        const core::position_store store(path, FINGERPRINT);
+        uint64_t value = 0;
+        check(std::none_of(
+                  torn.begin(), torn.end(),
+                  [&](uint64_t key) { return store.find(key, value); }),
+              "position store found a key of a torn run");
+    }
+
+    bool thrown = false;
+    try {
+        core::position_store store(path, FINGERPRINT + 1);
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    check(thrown, "position store opened with other settings");
+    // the file may also be written with other settings after opening
+    thrown = false;
+    try {
+        remove_files();
+        core::position_store store(path, FINGERPRINT + 1);
+        {
+            core::position_store other(path, FINGERPRINT);
+            other.record(1, value_at(3));
+            other.merge();
+        }
+        store.record(2, value_at(3));
+        store.merge();
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    check(thrown, "position store merged into with other settings");
+    thrown = false;
+    write_file(path, std::vector<uint8_t>(64, 7));
+    try {
+        core::position_store store(path, FINGERPRINT);
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    check(thrown, "position store opened on another file");
+    remove_files();
+}
+
+// A network trained for a few games values every board the same once saved
+// and mapped back, and the same on all eight images of a board; files with
+// a bad header or cut short are refused.
+void test_ntuple_network(std::mt19937_64& engine) {
+    core::ntuple_network network(core::ntuple_network::four_tuples());
+    core::rng games(2048);
+    for (int i = 0; i < 20; ++i) {
+        train::learn_game(network, 0.1f, games);
+    }
+    const std::string path = temp_path("2048-test-weights.ntn");
+    network.save(path);
+    // the images sum the same weights in another order
+    const auto same_value = [](double a, double b) {
+        return std::abs(a - b) <= 1e-4 * std::max(1.0, std::abs(a));
+    };
+    bool trained = false;
+    {
+        const auto loaded = core::ntuple_network::load(path);
+        check(loaded->tuples() == network.tuples(), "n-tuple tuples loaded");
+        for (int i = 0; i < 2000; ++i) {
+            const core::bitboard board(random_board(4, 12, engine));
+            const float value = network.value(board.raw());
+            trained = trained || value != 0;
+            check(loaded->value(board.raw()) == value &&
+                      loaded->evaluate(board) == network.evaluate(board),
+                  "n-tuple value loaded " + std::to_string(i));
+            for (int sym = 1; sym < core::symmetry::COUNT; ++sym) {
+                const core::bitboard image =
+                    core::symmetry::apply(board, sym);
+                check(same_value(value, network.value(image.raw())) &&
+                          same_value(network.evaluate(board),
+                                     network.evaluate(image)),
+                      "n-tuple value of image " + std::to_string(sym));
+            }
+        }
+    }
+    check(trained, "n-tuple network learned nothing");
+
+    // the board size is at offset 8, the tuple count at 12, the first
+    // tuple's length at 16 and its cells from 20
+    const std::vector<uint8_t> file = read_file(path);
+    const auto refused = [&](std::vector<uint8_t> bytes,
+                             const std::string& what) {
+        write_file(path, bytes);
+        bool thrown = false;
+        try {
+            core::ntuple_network::load(path);
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        check(thrown, "n-tuple file with " + what);
+    };
+    const auto with = [&](size_t offset, uint32_t value) {
+        std::vector<uint8_t> bytes = file;
+        std::memcpy(bytes.data() + offset, &value, sizeof(value));
+        return bytes;
+    };
+    std::vector<uint8_t> bytes = file;
+    bytes[0] ^= 1;
+    refused(bytes, "bad magic");
+    refused(with(8, 5), "another board size");
+    refused(with(12, 1000), "too many tuples");
+    refused(with(12, 4), "too few tuples");
+    refused(with(16, 0), "an empty tuple");
+    refused(with(16, 7), "a tuple too long");
+    bytes = file;
+    bytes[21] = bytes[20];
+    refused(bytes, "a repeated cell");
+    bytes = file;
+    bytes[20] = 16;
+    refused(bytes, "a cell off the board");
+    refused(std::vector<uint8_t>(file.begin(), file.end() - 4),
+            "the last weight cut off");
+    refused(std::vector<uint8_t>(file.begin(), file.begin() + 12),
+            "a short header");
+    std::filesystem::remove(path);
+}
+
+// Undo and redo across the 32-move snapshots, and a new move after undoing
+// dropping the moves undone, also those past a later snapshot.
+void test_game_history(std::mt19937_64& engine) {
+    for (int size : {4, 7}) {
+        core::board_2048 board(size, engine());
+        core::game_history history(board, 5);
+        std::vector<core::board_2048> positions{board};
+        std::vector<int> generations{5};
+        auto play = [&](int moves) {
+            for (int i = 0; i < moves && !board.is_over(); ++i) {
+                int dir = int(engine() % 4);
+                while (!board.valid_move(dir)) {
+                    dir = (dir + 1) % 4;
+                }
+                board.move(dir);
+                const int cell = board.add_random_tile();
+                const int generation = int(engine() % 256);
+                history.push(board, dir, cell,
+                             board.get_tile(cell / size, cell % size),
+                             generation);
+                positions.resize(size_t(history.position()));
+                positions.push_back(board);
+                generations.resize(size_t(history.position()));
+                generations.push_back(generation);
+            }
+        };
+        auto at = [&](const std::string& what) {
+            const size_t i = size_t(history.position());
+            check(history.size() + 1 == int(positions.size()) &&
+                      same_tiles(board, positions[i]) &&
+                      board.get_score() == positions[i].get_score() &&
+                      history.generation() == generations[i],
+                  "history " + what + " at " + std::to_string(i) + ", " +
+                      std::to_string(size) + "x" + std::to_string(size));
+        };
+
+        play(100);
+        const int played = history.size();
+        check(played > core::game_history::SNAPSHOT_INTERVAL + 1,
+              "history game too short to cross a snapshot");
+        while (history.undo(board)) {
+            at("undo");
+        }
+        check(history.position() == 0 && !history.can_undo(),
+              "history undo to the start");
+        while (history.redo(board)) {
+            at("redo");
+        }
+        check(history.position() == played && !history.can_redo(),
+              "history redo to the end");
+        for (int i = 0; i < 200; ++i) {
+            check(history.seek(int(engine() % uint64_t(played + 1)), board),
+                  "history seek");
+            at("seek");
+        }
+        check(!history.seek(-1, board) && !history.seek(played + 1, board),
+              "history seek out of range");
+
+        // back to just past the first snapshot, then a new line of play
+        history.seek(core::game_history::SNAPSHOT_INTERVAL + 1, board);
+        play(60);
+        at("push after undo");
+        check(!history.can_redo(), "history redo after a new move");
+        for (int i = history.size(); i >= 0; --i) {
+            history.seek(i, board);
+            at("seek after truncate");
+        }
+    }
+}
+}  // namespace
+
+int main() {
+    std::mt19937_64 engine(2048);
+    test_fixed_moves();
+    test_fixed_legal_moves();
+    test_row_tables();
+    test_board_2048_moves(engine);
+    test_tile_moves(engine);
+    test_board_t<3>(engine);
+    test_board_t<4>(engine);
+    test_board_t<5>(engine);
+    test_board_t<6>(engine);
+    test_board_t<7>(engine);
+    test_board_t<8>(engine);
+    test_bitboard(engine);
+    test_symmetry(engine);
+    test_row_kernel(engine);
+    test_32768();
+    test_parallel_search();
+    test_record_round_trip(engine);
+    test_record_corruption(engine);
+    test_position_store(engine);
+    test_ntuple_network(engine);
+    test_game_history(engine);
+    if (failures != 0) {
+        std::cerr << failures << " checks failed\n";
+        return 1;
+    }
+    std::cerr << "all checks passed\n";
+    return 0;
+}
@@ -0,0 +1,112 @@
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "train/td.hpp"
+
+namespace {
+void usage(const char* prog) {
+    std::cerr
+        << "usage: " << prog << " [options]\n"
+        << "  --games N      self-play games to learn from (100000)\n"
+        << "  --alpha A      learning rate (0.1)\n"
+        << "  --tuples K     4 or 6: the tuple set of a new network (4)\n"
+        << "  --init FILE    keep training the network in FILE\n"
+        << "  --seed X       seed of the self-play spawns (0)\n"
+        << "  --report N     print progress every N games (1000)\n"
+        << "  --out FILE     where to write the weights (weights.ntn)\n";
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    int games = 100000;
+    float alpha = 0.1f;
+    int tuples = 4;
+    int report = 1000;
+    uint64_t seed = 0;
+    std::string init_path, out_path = "weights.ntn";
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            usage(argv[0]);
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        const char* value = argv[++i];
+        try {
+            if (arg == "--games") {
+                games = std::stoi(value);
+            } else if (arg == "--alpha") {
+                alpha = std::stof(value);
+            } else if (arg == "--tuples") {
+                tuples = std::stoi(value);
+            } else if (arg == "--init") {
+                init_path = value;
+            } else if (arg == "--seed") {
+                seed = std::stoull(value);
+            } else if (arg == "--report") {
+                report = std::stoi(value);
+            } else if (arg == "--out") {
+                out_path = value;
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "invalid value for " << arg << ": " << value << "\n";
+            return 1;
+        }
+    }
+    if (games < 0 || alpha <= 0 || report <= 0 ||
+        (tuples != 4 && tuples != 6)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::unique_ptr<core::ntuple_network> network;
+    try {
+        network = init_path.empty()
+                      ? std::make_unique<core::ntuple_network>(
+                            tuples == 4 ? core::ntuple_network::four_tuples()
+                                        : core::ntuple_network::six_tuples())
+                      : std::make_unique<core::ntuple_network>(
+                            *core::ntuple_network::load(init_path));
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+
+    core::rng engine(seed);
+    uint64_t total_score = 0;
+    std::map<int, int> max_tiles;
+    for (int game = 1; game <= games; ++game) {
+        const train::td_game result =
+            train::learn_game(*network, alpha, engine);
+        total_score += result.score;
+        ++max_tiles[result.max_tile];
+        if (game % report == 0 || game == games) {
+            const int played = game % report == 0 ? report : game % report;
+            std::cerr << "games: " << game
+                      << "  mean score: " << double(total_score) / played;
+            int reached = 0;  // games of the window reaching 2048 or more
+            for (auto& [tile, count] : max_tiles) {
+                reached += tile >= 2048 ? count : 0;
+            }
+            std::cerr << "  2048 rate: " << 100.0 * reached / played << "%\n";
+            total_score = 0;
+            max_tiles.clear();
+        }
+    }
+
+    try {
+        network->save(out_path);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}